@@ -1,6 +1,7 @@
 #ifndef BITBOARD_H
 #define BITBOARD_H
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iostream>
@@ -8,6 +9,10 @@
 
 #include "types.h"
 
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
 namespace Juujfish {
 
 namespace BitBoards {
@@ -32,6 +37,8 @@ constexpr BitBoard RANK_6_BB = 0x0000FF0000000000ULL;
 constexpr BitBoard RANK_7_BB = 0x00FF000000000000ULL;
 constexpr BitBoard RANK_8_BB = 0xFF00000000000000ULL;
 
+constexpr BitBoard DARK_SQUARES = 0xAA55AA55AA55AA55ULL;
+
 extern BitBoard PawnPushes[COLOR_NB][SQUARE_NB];
 extern BitBoard PawnAttacks[COLOR_NB][SQUARE_NB];
 extern BitBoard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
@@ -134,6 +141,16 @@ inline int manhattan_distance(Square s1, Square s2) {
   return abs(file_of(s1) - file_of(s2)) + abs(rank_of(s1) - rank_of(s2));
 }
 
+// Number of king moves between two squares
+inline int distance(Square s1, Square s2) {
+  return std::max(abs(file_of(s1) - file_of(s2)),
+                  abs(rank_of(s1) - rank_of(s2)));
+}
+
+constexpr bool opposite_colors(Square s1, Square s2) {
+  return bool(DARK_SQUARES & (1ULL << s1)) != bool(DARK_SQUARES & (1ULL << s2));
+}
+
 template <Direction D>
 constexpr BitBoard shift(BitBoard b) {
   return D == NORTH           ? (b & ~RANK_8_BB) << 8
@@ -149,7 +166,8 @@ constexpr BitBoard shift(BitBoard b) {
                               : 0;
 }
 
-// Magic bitboards:
+// Magic bitboards. With USE_PEXT the relevant occupancy bits are extracted
+// directly and the magic multiply is not used.
 struct Magic {
   BitBoard mask;
   BitBoard magic;
@@ -157,7 +175,11 @@ struct Magic {
   BitBoard* attacks;
 
   unsigned index(BitBoard occupied) const {
+#ifdef USE_PEXT
+    return unsigned(_pext_u64(occupied, mask));
+#else
     return ((occupied & mask) * magic) >> (64 - shift);
+#endif
   }
   BitBoard attacks_bb(BitBoard occupied) { return attacks[index(occupied)]; }
 };
@@ -165,24 +187,9 @@ struct Magic {
 extern Magic Magics[SQUARE_NB][2];
 
 void init_magics();
-Magic find_magic(Square s, PieceType pt, int sliding_attacks_index);
-bool try_magic(Magic& magic, std::vector<BitBoard>& blocker_bitboards,
-               std::vector<BitBoard>& attacks_vec);
 
 BitBoard generate_sliding_attacks(Square s, PieceType pt, BitBoard occupied);
 BitBoard generate_movement_mask(Square s, PieceType pt);
-std::vector<BitBoard> generate_blocker_bitboards(Square s, PieceType pt);
-
-inline BitBoard random_bb() {
-  std::random_device rd;
-  std::mt19937_64 gen(rd());
-  std::uniform_int_distribution<uint64_t> dist(0, UINT64_MAX);
-  return dist(gen);
-}
-
-inline BitBoard random_magic_candidate() {
-  return random_bb() & random_bb() & random_bb();
-}
 
 inline int popcount(BitBoard b) {
   return __builtin_popcountll(b);  //gcc
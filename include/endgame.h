@@ -0,0 +1,50 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "bitboard.h"
+#include "pawns.h"
+#include "position.h"
+#include "types.h"
+
+namespace Juujfish {
+
+namespace Bitbases {
+
+// Solves king and pawn against king by retrograde analysis, must be called
+// after BitBoards::init
+void init();
+
+// Whether white wins with the pawn on the a- to d-file
+bool probe(Square wksq, Square wpsq, Square bksq, Color side_to_move);
+
+}  // namespace Bitbases
+
+// The endgame value is multiplied by the scale factor over the normal one
+constexpr int SCALE_FACTOR_DRAW = 0;
+constexpr int SCALE_FACTOR_NORMAL = 64;
+constexpr int SCALE_FACTOR_NONE = 255;
+
+// Exact evaluation of a known ending, from the point of view of the strong
+// side
+using EndgameValue = Value (*)(const Position& pos, Color strong_side);
+
+// Scale factor of the endgame value for the strong side, SCALE_FACTOR_NONE
+// when the position does not qualify
+using EndgameScale = int (*)(const Position& pos, const PawnEntry* pawns,
+                             Color strong_side);
+
+namespace Endgames {
+
+Value KPK(const Position& pos, Color strong_side);
+Value KBNK(const Position& pos, Color strong_side);
+Value KRK(const Position& pos, Color strong_side);
+
+// Each side has a single bishop, drawish when they are on opposite colors
+int opposite_bishops(const Position& pos, const PawnEntry* pawns,
+                     Color strong_side);
+
+}  // namespace Endgames
+
+}  // namespace Juujfish
+
+#endif  // ifndef ENDGAME_H
@@ -1,48 +1,85 @@
 #ifndef EVALUATION_H
 #define EVALUATION_H
 
+#include <algorithm>
+
 #include "bitboard.h"
+#include "material.h"
 #include "movegen.h"
+#include "pawns.h"
 #include "position.h"
 #include "types.h"
 
 namespace Juujfish {
 
-enum Phase { OPENING, MIDDLEGAME, ENDGAME };
+// Material and centralization are in the piece-square tables of psqt.h and
+// are kept up to date incrementally, these are the terms computed per leaf
 
-constexpr BitBoard INNER_CENTER = 103481868288ULL;
-constexpr BitBoard OUTER_CENTER = 66229406269440ULL;
+// Per square of the mobility area a piece attacks, counted from the average
+// mobility of the piece type
+constexpr Score MobilityBonus[PIECE_TYPE_NB] = {
+    SCORE_ZERO,         make_score(8, 8), make_score(6, 6),
+    make_score(3, 6),   make_score(2, 4), SCORE_ZERO};
+constexpr int MobilityAverage[PIECE_TYPE_NB] = {0, 4, 6, 7, 13, 0};
 
-constexpr Value ACTIVITY_WEIGHT = 2;
-constexpr Value KING_SAFETY_WEIGHT = 5;
-constexpr Value INNER_CENTER_BONUS = 10;
-constexpr Value OUTER_CENTER_BONUS = 5;
-constexpr Value ROOKS_CONNECTED_BONUS = 20;
-constexpr Value OPEN_FILE_BONUS = 20;
-constexpr Value PASS_PAWN_BONUS = 30;
+constexpr Score ROOKS_CONNECTED_BONUS = make_score(20, 20);
+constexpr Score ROOK_OPEN_FILE_BONUS = make_score(20, 20);
 
-Phase get_game_phase(Position& pos);
+// Knight or bishop on the fourth to sixth rank, protected by a pawn and out
+// of reach of the enemy pawns
+constexpr Score OUTPOST_BONUS = make_score(25, 10);
 
-template <Color C, Phase P>
-Value score_material(Position& pos);
+constexpr Score KING_ZONE_DEFENSE = make_score(3, 3);  // Per attack
+constexpr Score KING_ZONE_ATTACK = make_score(1, 1);
 
-template <Color C, Phase P, PieceType Pt>
-Value score_material(Position& pos);
+constexpr Score THREAT_BY_PAWN = make_score(40, 30);  // On a piece
+constexpr Score THREAT_BY_MINOR = make_score(30, 20);  // On a rook or queen
+constexpr Score HANGING_PIECE = make_score(30, 20);    // Attacked, undefended
 
-template <Color C, Phase P>
-Value score_king_safety(Position& pos);
+/*
+  Attack maps built in a single pass over the pieces and shared by the
+  mobility, king safety and threat terms. The mobility area of a side leaves
+  out its blocked pawns, its king and the squares attacked by enemy pawns.
+*/
+struct EvalInfo {
+  BitBoard attacked_by[COLOR_NB][PIECE_TYPE_NB];
+  BitBoard attacked[COLOR_NB];  // By any piece
+  BitBoard mobility_area[COLOR_NB];
+  BitBoard king_zone[COLOR_NB];
 
-template <Color C, Phase P>
-Value score_pawns(Position& pos);
+  PawnEntry* pawns;
 
-inline Value score_tempo(Position& pos) {
-  return MoveList<LEGAL>(pos).size();
-}
+  // Attacks of the pieces of a side on its own and on the enemy king zone
+  int king_zone_defenses[COLOR_NB];
+  int king_zone_attacks[COLOR_NB];
+};
+
+template <Color C>
+void init_eval_info(Position& pos, EvalInfo& ei);
+
+template <Color C, PieceType Pt>
+Score score_pieces(Position& pos, EvalInfo& ei);
 
-template <Color C, Phase P>
-Value evaluate(Position& pos);
+template <Color C>
+Score score_king_safety(Position& pos, const EvalInfo& ei);
+
+template <Color C>
+Score score_threats(Position& pos, const EvalInfo& ei);
+
+// Interpolates between the middlegame and the endgame value by the phase,
+// the endgame value scaled down first for drawish material
+inline Value taper(Score score, int phase, int sf = SCALE_FACTOR_NORMAL) {
+  phase = std::min(phase, MAX_PHASE);  // Promotions can add material
+
+  return (mg_value(score) * phase +
+          eg_value(score) * (MAX_PHASE - phase) * sf / SCALE_FACTOR_NORMAL) /
+         MAX_PHASE;
+}
 
-Value evaluate(Position& pos);
+// Evaluates the position from white's point of view. The pawn structure and
+// the material are looked up in the tables of the calling thread.
+Value evaluate(Position& pos, PawnTable& pawn_table,
+               MaterialTable& material_table);
 
 }  // namespace Juujfish
 
@@ -0,0 +1,34 @@
+#ifndef LARGEPAGE_H
+#define LARGEPAGE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Juujfish {
+
+constexpr size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;  // 2 MiB
+
+// How the pages backing a large allocation were obtained
+enum LargePageMode : uint8_t {
+  NORMAL_PAGES,            // Plain aligned allocation
+  TRANSPARENT_HUGE_PAGES,  // 2 MiB aligned memory advised with MADV_HUGEPAGE
+  HUGETLB_PAGES            // Explicit huge pages from mmap with MAP_HUGETLB
+};
+
+const char* to_string(LargePageMode mode);
+
+/*
+  Allocates size bytes, aligned to at least LARGE_PAGE_SIZE, for big tables
+  that are probed randomly (transposition table, pawn hash, ...). Large pages
+  cut the dTLB misses of these probes. Explicit huge pages are tried first,
+  then transparent huge pages, and mode reports which one was obtained.
+  Returns nullptr on failure. The memory is not zeroed.
+*/
+void* large_page_alloc(size_t size, LargePageMode& mode);
+
+// Frees memory from large_page_alloc, given the same size and mode
+void large_page_free(void* mem, size_t size, LargePageMode mode);
+
+}  // namespace Juujfish
+
+#endif  // ifndef LARGEPAGE_H
@@ -0,0 +1,84 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "endgame.h"
+#include "pawns.h"
+#include "position.h"
+#include "types.h"
+
+namespace Juujfish {
+
+// Entries per thread, a power of two
+constexpr size_t MATERIAL_TABLE_SIZE = 8192;
+
+constexpr Score BISHOP_PAIR_BONUS = make_score(30, 50);
+
+// Per own pawn above five, knights gain and rooks lose value as the position
+// gets more closed
+constexpr Score KNIGHT_PAWN_ADJUSTMENT = make_score(5, 6);
+constexpr Score ROOK_PAWN_ADJUSTMENT = make_score(10, 12);
+
+/*
+  Everything the evaluation derives from the piece counts alone: the
+  imbalance between the pieces, a known ending with its exact evaluation, and
+  how much of the endgame value a side can expect to convert.
+*/
+struct MaterialEntry {
+  Score get_imbalance() const { return imbalance; }
+  bool has_endgame() const { return endgame != nullptr; }
+
+  // The value of a known ending from white's point of view
+  Value evaluate(const Position& pos) const {
+    Value v = endgame(pos, strong_side);
+    return strong_side == WHITE ? v : -v;
+  }
+
+  // The scale factor of side c, refined by the pieces' squares only when the
+  // material alone leaves it normal
+  int scale_factor(const Position& pos, const PawnEntry* pawns,
+                   Color c) const {
+    int sf = factor[c];
+
+    if (sf == SCALE_FACTOR_NORMAL && scaling) {
+      int scaled = scaling(pos, pawns, c);
+      if (scaled != SCALE_FACTOR_NONE)
+        sf = scaled;
+    }
+
+    return sf;
+  }
+
+  Key key;
+  Score imbalance;
+
+  EndgameValue endgame;
+  EndgameScale scaling;
+  Color strong_side;
+
+  uint8_t factor[COLOR_NB];
+};
+
+/*
+  Per thread hash table of material configurations, indexed by the material
+  key of the position. Captures and promotions are the only moves that change
+  it, so nearly every probe hits.
+*/
+class MaterialTable {
+ public:
+  MaterialTable() { clear(); }
+
+  void clear();
+
+  // Returns the entry of the position's material, computed if it was missing
+  MaterialEntry* probe(const Position& pos);
+
+ private:
+  MaterialEntry entries[MATERIAL_TABLE_SIZE];
+};
+
+}  // namespace Juujfish
+
+#endif  // ifndef MATERIAL_H
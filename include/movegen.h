@@ -1,6 +1,8 @@
 #ifndef MOVEGEN_H
 #define MOVEGEN_H
 
+#include <algorithm>
+
 #include "bitboard.h"
 #include "position.h"
 #include "types.h"
@@ -24,7 +24,12 @@ enum Stage {
   // EVASIONS:
   EVASION_TT,
   EVASION_GEN,
-  EVASION
+  EVASION,
+
+  // QUIESCENCE:
+  QSEARCH_TT,
+  QCAPTURES_GEN,
+  QCAPTURE
 };
 
 inline Stage& operator++(Stage& stage) {
@@ -36,18 +41,27 @@ class MoveOrderer {
  public:
   MoveOrderer(const Position& pos, const Move table_move, int ply,
               const KillerHeuristic* kh, const HistoryHeuristic* hh,
-              const ButterflyHeuristic* bh)
+              const ButterflyHeuristic* bh, bool captures_only = false)
       : pos(pos),
-        table_move(table_move),
+        table_move(pos.pseudo_legal(table_move) && pos.legal(table_move)
+                       ? table_move
+                       : Move::null_move()),
         ply(ply),
         killers(kh),
         history(hh),
         butterfly(bh) {
-    stage = pos.is_in_check() ? EVASION_TT : GENERAL_TT;
+    // The table move is the only move not coming from the legal generator.
+    // Quiescence search only looks at captures and promotions, unless in check.
+    stage = pos.is_in_check() ? EVASION_TT
+            : captures_only   ? QSEARCH_TT
+                              : GENERAL_TT;
   }
   Move next();
   void skip_quiets_moves() { skip_quiets = true; }
 
+  // Stage of the move last returned by next()
+  Stage get_stage() const { return stage; }
+
  private:
   template <typename Pred>
   Move select(Pred filter);
@@ -0,0 +1,74 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+namespace Juujfish {
+
+class Position;
+
+/*
+HalfKP network, in the file format of the first Stockfish NNUE nets
+(256x2-32-32-1):
+
+Feature transformer - 41024 inputs to 256 int16 per perspective, kept up to
+                      date incrementally in the StateInfo accumulators
+Hidden layer 1      - 512 to 32, int8 weights on clipped uint8 inputs
+Hidden layer 2      - 32 to 32
+Output layer        - 32 to 1
+
+An input feature is the square of a non-king piece relative to the square of
+the perspective's own king, both seen from that perspective.
+*/
+constexpr int NNUE_HALF_DIMENSIONS = 256;
+constexpr int NNUE_PS_END = 641;  // Piece-square features per king square
+constexpr int NNUE_INPUT_DIMENSIONS = SQUARE_NB * NNUE_PS_END;
+constexpr int NNUE_HIDDEN_DIMENSIONS = 32;
+
+constexpr std::uint32_t NNUE_VERSION = 0x7AF32F16;
+
+// Output scaling: the network output is divided by NNUE_FV_SCALE and is then
+// in units where a pawn is worth NNUE_PAWN_VALUE
+constexpr int NNUE_FV_SCALE = 16;
+constexpr int NNUE_PAWN_VALUE = 208;
+constexpr int NNUE_WEIGHT_SCALE_BITS = 6;
+
+// Accumulators are not worth updating incrementally over more plies than this
+constexpr int NNUE_MAX_UPDATE_PLIES = 8;
+
+// Pieces added, moved or removed by the last move. A piece is added if its
+// from square is SQ_NONE and removed if its to square is SQ_NONE.
+struct DirtyPiece {
+  int dirty_num;
+  Piece piece[3];
+  Square from[3];
+  Square to[3];
+};
+
+// Feature transformer output of a position for both perspectives
+struct Accumulator {
+  alignas(64) std::int16_t accumulation[COLOR_NB][NNUE_HALF_DIMENSIONS];
+  bool computed[COLOR_NB];
+};
+
+namespace NNUE {
+
+// Loads a network file, on failure the current network, if any, is kept.
+// Without a network the hand-crafted evaluation is used.
+bool load(const std::string& path);
+void unload();
+
+bool is_loaded();
+const std::string& loaded_file();
+
+// Evaluates the position from the side to move's point of view
+Value evaluate(Position& pos);
+
+}  // namespace NNUE
+
+}  // namespace Juujfish
+
+#endif  // ifndef NNUE_H
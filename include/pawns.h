@@ -0,0 +1,93 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include <cstddef>
+
+#include "bitboard.h"
+#include "largepage.h"
+#include "position.h"
+#include "types.h"
+
+namespace Juujfish {
+
+constexpr Score PROTECTED_PAWN_BONUS = make_score(5, 5);
+constexpr Score ISOLATED_PAWN_PENALTY = make_score(15, 20);
+
+// Passed pawn bonus by relative rank
+constexpr Score PassedPawnBonus[RANK_NB] = {
+    SCORE_ZERO,         make_score(5, 10),  make_score(5, 15),
+    make_score(10, 25), make_score(25, 50), make_score(50, 90),
+    make_score(80, 140), SCORE_ZERO};
+
+constexpr Score PAWN_SHIELD_BONUS = make_score(30, 0);
+constexpr Score NO_PAWN_SHIELD_PENALTY = make_score(75, 0);
+constexpr Score KING_OPEN_FILE_PENALTY = make_score(20, 20);
+
+/*
+  Everything the evaluation derives from the pawns alone, one cache line per
+  pawn structure. The shelter of a king also depends on its square and is
+  computed on demand, then kept until the king moves.
+*/
+struct alignas(64) PawnEntry {
+  Score pawn_score() const { return scores[WHITE] - scores[BLACK]; }
+  BitBoard passed(Color c) const { return passed_pawns[c]; }
+  BitBoard attacks_span(Color c) const { return pawn_attacks_span[c]; }
+
+  template <Color C>
+  Score king_shelter(const Position& pos) {
+    Square king_sq = lsb(pos.pieces(C, KING));
+
+    if (king_squares[C] != king_sq) {
+      king_squares[C] = king_sq;
+      shelter[C] = evaluate_shelter<C>(pos, king_sq);
+    }
+
+    return shelter[C];
+  }
+
+  template <Color C>
+  Score evaluate_shelter(const Position& pos, Square king_sq) const;
+
+  Key key;
+  Score scores[COLOR_NB];
+  BitBoard passed_pawns[COLOR_NB];
+
+  // Squares the pawns attack now or after advancing
+  BitBoard pawn_attacks_span[COLOR_NB];
+
+  Square king_squares[COLOR_NB];
+  Score shelter[COLOR_NB];
+};
+
+static_assert(sizeof(PawnEntry) == 64, "A pawn entry is one cache line");
+
+// Entries per thread, a power of two filling one large page
+constexpr size_t PAWN_TABLE_SIZE = LARGE_PAGE_SIZE / sizeof(PawnEntry);
+
+/*
+  Per thread hash table of pawn structures, indexed by the pawn key of the
+  position. Only pawn moves and pawn captures change the key, so most probes
+  hit and the pawn evaluation is recomputed only for new structures. The
+  entries are probed randomly, so they live on a large page.
+*/
+class PawnTable {
+ public:
+  PawnTable();
+  ~PawnTable();
+
+  PawnTable(const PawnTable& t) = delete;
+  PawnTable& operator=(const PawnTable& t) = delete;
+
+  void clear();
+
+  // Returns the entry of the position's pawns, computed if it was missing
+  PawnEntry* probe(const Position& pos);
+
+ private:
+  PawnEntry* entries;
+  LargePageMode large_page_mode = NORMAL_PAGES;
+};
+
+}  // namespace Juujfish
+
+#endif  // ifndef PAWNS_H
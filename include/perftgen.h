@@ -0,0 +1,81 @@
+#ifndef PERFTGEN_H
+#define PERFTGEN_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "largepage.h"
+#include "position.h"
+#include "types.h"
+
+namespace Juujfish {
+
+class ThreadPool;
+
+constexpr size_t PERFT_BUCKET_SIZE = 2;
+
+// Table size in MiB, zero disables the hashing
+constexpr size_t DEFAULT_PERFT_HASH_MB = 64;
+
+// Subtrees of depth 1 are bulk counted, so only deeper ones are worth caching
+constexpr Depth PERFT_HASH_MIN_DEPTH = 2;
+
+/*
+Subtree counts keyed by position and depth. The data word holds the node
+count in its upper 56 bits and the depth in the low byte, and the stored key
+is XORed with the data word, so that an entry torn by two threads writing it
+at once does not match any position.
+*/
+struct PerftEntry {
+  std::atomic<std::uint64_t> key;
+  std::atomic<std::uint64_t> data;
+};
+
+// The first entry of a bucket keeps the deepest subtree, the second one is
+// always replaced
+struct PerftBucket {
+  PerftEntry entries[PERFT_BUCKET_SIZE];
+};
+
+static_assert(sizeof(PerftBucket) == 32, "Error: PerftBucket must be 32 bytes");
+
+class PerftTable {
+ public:
+  ~PerftTable() { free(); }
+
+  // Reallocates the table to the given size in MiB and zeroes it
+  void resize(size_t mb);
+
+  bool probe(Key zobrist_key, Depth depth, std::uint64_t& nodes) const;
+  void store(Key zobrist_key, Depth depth, std::uint64_t nodes);
+
+ private:
+  void free();
+
+  inline size_t bucket_index(Key zobrist_key) const {
+    return (unsigned __int128)zobrist_key * bucket_count >> 64;
+  }
+
+  size_t bucket_count = 0;
+  PerftBucket* table = nullptr;
+  LargePageMode large_page_mode = NORMAL_PAGES;
+};
+
+namespace Perft {
+
+/*
+  Counts the leaves of the legal move tree to the given depth. The root moves
+  are handed out to the threads of the pool one at a time, the last ply is
+  bulk counted from the size of the move list, and subtree counts are shared
+  between the threads through a table of hash_mb MiB, kept from one call to
+  the next. Prints the count of every root move when divide is set.
+*/
+std::uint64_t perft(Position& pos, Depth depth, ThreadPool& threads,
+                    size_t hash_mb = DEFAULT_PERFT_HASH_MB,
+                    bool divide = true);
+
+}  // namespace Perft
+
+}  // namespace Juujfish
+
+#endif  // ifndef PERFTGEN_H
@@ -2,26 +2,44 @@
 #define POSITION_H
 
 #include "bitboard.h"
+#include "nnue.h"
+#include "psqt.h"
 #include "types.h"
 
+#include <cstddef>
 #include <cstring>
 #include <deque>
 #include <iostream>
+#include <memory>
 
 namespace Juujfish {
 
 struct StateInfo {
+  // Carried over from the previous state by make_move and updated in place
   Key zobrist_key;
 
   Key pawn_key;
   Key minor_key;
   Key major_key;
 
+  // Keyed by piece counts alone, the n-th piece of a kind hashes as if it
+  // stood on square n
+  Key material_key;
+
   int fifty_move_counter;
   int plies_from_start;
-  int repetition;
+  int plies_from_null;
 
   CastlingRights castling_rights;
+
+  // Updated by set_piece and remove_piece
+  Score psq_score;  // Material and piece-square bonuses, white's view
+  Value non_pawn_material[COLOR_NB];
+  int phase;
+
+  // Recomputed from scratch on every move, never copied
+  int repetition;
+
   bool can_ep;
   Square ep_square;
 
@@ -32,19 +50,28 @@ struct StateInfo {
   BitBoard blockers[COLOR_NB];  // Pieces blocking sliding attacks to the king
   BitBoard pinners[COLOR_NB];   // Pinners to the king
 
+  // Lines from the king up to and including the pinners of its own pieces
+  BitBoard pin_hv_mask[COLOR_NB];
+  BitBoard pin_diag_mask[COLOR_NB];
+
   Color side_to_move;
   Move previous_move;
   Piece captured_piece;
 
   struct StateInfo* prev;
   struct StateInfo* next;
+
+  // Set by make_move, the accumulator is computed lazily by the evaluation
+  DirtyPiece dirty_piece;
+  Accumulator accumulator;
 };
 
 extern BitBoard CastlingPaths[4];
 extern BitBoard CastlingRookSquares[4];
 
-inline void copy_state(StateInfo* dest, StateInfo* src) {
-  std::memcpy(dest, src, sizeof(struct StateInfo));
+// Copies only the incrementally updated fields, up to repetition
+inline void copy_state_prefix(StateInfo* dest, const StateInfo* src) {
+  std::memcpy(dest, src, offsetof(struct StateInfo, repetition));
 }
 
 using StatesDequePtr = std::unique_ptr<std::deque<StateInfo>>;
@@ -62,30 +89,39 @@ class Position {
 
   constexpr StateInfo* get_state() const { return st; }
   constexpr Key get_key() const { return st->zobrist_key; }
+  Key key_after(Move m) const;
   constexpr Key get_pawn_key() const { return st->pawn_key; }
   constexpr Key get_minor_key() const { return st->minor_key; }
   constexpr Key get_major_key() const { return st->major_key; }
+  constexpr Key get_material_key() const { return st->material_key; }
   constexpr int get_repetition() const { return st->repetition; }
   constexpr int get_fifty_move_counter() const {
     return st->fifty_move_counter;
   }
   constexpr int get_plies_from_start() const { return st->plies_from_start; }
+  constexpr int get_plies_from_null() const { return st->plies_from_null; }
   constexpr Color get_side_to_move() const { return st->side_to_move; }
   constexpr CastlingRights get_castling_rights() const {
     return st->castling_rights;
   }
+  constexpr Score get_psq_score() const { return st->psq_score; }
+  constexpr int get_phase() const { return st->phase; }
   constexpr bool is_in_check() const { return st->in_check; }
   constexpr BitBoard get_checkers() const { return st->checkersBB; }
   constexpr BitBoard get_blockers(Color c) const { return st->blockers[c]; }
   constexpr BitBoard get_pinners(Color c) const { return st->pinners[c]; }
+  constexpr BitBoard get_pin_hv_mask(Color c) const {
+    return st->pin_hv_mask[c];
+  }
+  constexpr BitBoard get_pin_diag_mask(Color c) const {
+    return st->pin_diag_mask[c];
+  }
   constexpr bool can_en_passant() const { return st->can_ep; }
   constexpr Square get_ep_square() const { return st->ep_square; }
   constexpr BitBoard get_check_squares(PieceType pt) const {
     return st->check_squares[pt];
   }
 
-  void copy(const Position& pos);
-
   inline bool can_castle(CastlingRights cr) const {
     return (st->castling_rights & cr) != 0;
   }
@@ -110,6 +146,8 @@ class Position {
 
   bool is_capture(Move m) const;
 
+  Value non_pawn_material(Color c) const;
+
   void make_move(Move m, StateInfo* new_st, bool gives_check);
   void do_castling(Color c, Square to, Square from, Square rto, Square rfrom);
   void do_en_passant(Color c, Square to, Square from, Square capture_sq);
@@ -120,9 +158,15 @@ class Position {
   void undo_en_passant(Color c, Square to, Square from, Square capture_sq);
   void undo_promotion(Color c, Square to, Square from);
 
+  void make_null_move(StateInfo* new_st);
+  void unmake_null_move();
+
   int count_attacks(Color c, const BitBoard zone) const;
   bool sq_is_attacked(Color c, Square s, BitBoard occupied) const;
   BitBoard attacked_by(Color c, Square s) const;
+  BitBoard attacked_by(Square s, BitBoard occupied) const;
+
+  bool see_ge(Move m, Value threshold = VALUE_ZERO) const;
 
   template <PieceType Pt>
   BitBoard attacks_by(Color c) const;
@@ -148,6 +192,7 @@ class Position {
   BitBoard pieceBB[COLOR_NB][PIECE_TYPE_NB];
   BitBoard colorBB[COLOR_NB];
   BitBoard boardBB;
+  Piece board[SQUARE_NB];  // Mailbox kept in sync with the bitboards
   StateInfo* st;
 };
 
@@ -204,6 +249,10 @@ inline BitBoard Position::pieces(Color c, PieceType pt) const {
   return pieceBB[c][pt];
 }
 
+inline Value Position::non_pawn_material(Color c) const {
+  return st->non_pawn_material[c];
+}
+
 inline Square castling_king_to(CastlingRights cr) {
   switch (cr) {
     case WHITE_OO:
@@ -221,14 +270,7 @@ inline Square castling_king_to(CastlingRights cr) {
 
 inline Piece Position::piece_at(Square s) const {
   assert(is_square(s));
-  for (int c = WHITE; c < COLOR_NB; ++c) {
-    for (int pt = PAWN; pt < PIECE_TYPE_NB; ++pt) {
-      if (pieceBB[c][pt] & square_to_bb(s)) {
-        return piece_of(Color(c), PieceType(pt));
-      }
-    }
-  }
-  return NO_PIECE;
+  return board[s];
 }
 
 inline bool Position::set_piece(Color c, PieceType pt, Square s) {
@@ -238,6 +280,12 @@ inline bool Position::set_piece(Color c, PieceType pt, Square s) {
     pieceBB[c][pt] |= bb;
     colorBB[c] |= bb;
     boardBB |= bb;
+    board[s] = piece_of(c, pt);
+
+    st->psq_score += PSQT::psq[board[s]][s];
+    st->phase += PiecePhase[pt];
+    if (pt != PAWN && pt != KING)
+      st->non_pawn_material[c] += PieceValue[pt];
     return true;
   } else
     return false;
@@ -253,6 +301,12 @@ inline bool Position::remove_piece(Square s) {
     pieceBB[c][pt] ^= bb;
     colorBB[c] ^= bb;
     boardBB ^= bb;
+    board[s] = NO_PIECE;
+
+    st->psq_score -= PSQT::psq[p][s];
+    st->phase -= PiecePhase[pt];
+    if (pt != PAWN && pt != KING)
+      st->non_pawn_material[c] -= PieceValue[pt];
     return true;
   } else
     return false;
@@ -0,0 +1,110 @@
+#ifndef PSQT_H
+#define PSQT_H
+
+#include "types.h"
+
+namespace Juujfish {
+namespace PSQT {
+
+// Material of each piece type in the middlegame and the endgame
+constexpr Score PieceScore[PIECE_TYPE_NB] = {
+    make_score(80, 100),  make_score(290, 270), make_score(320, 300),
+    make_score(480, 520), make_score(900, 940), SCORE_ZERO};
+
+#define S make_score
+
+/*
+  Piece-square bonuses for white, from rank 1 to rank 8 and from the a-file to
+  the d-file. The other half of the board is mirrored. Pieces are drawn to the
+  center, which matters less for a queen and most for a knight, pawns are
+  rewarded for holding the center and for advancing in the endgame, and the
+  king stays sheltered in the corner until the endgame, when it centralizes.
+*/
+constexpr Score Bonus[PIECE_TYPE_NB][RANK_NB][FILE_NB / 2] = {
+    // Pawn
+    {{S(0, 0), S(0, 0), S(0, 0), S(0, 0)},
+     {S(-10, -10), S(0, 0), S(0, 0), S(-5, 0)},
+     {S(-10, -10), S(0, 0), S(8, 0), S(8, 0)},
+     {S(-10, -10), S(0, 0), S(8, 0), S(20, 0)},
+     {S(-10, -5), S(0, 5), S(8, 5), S(20, 5)},
+     {S(-5, 20), S(5, 20), S(10, 20), S(10, 20)},
+     {S(10, 50), S(15, 50), S(15, 50), S(15, 50)},
+     {S(0, 0), S(0, 0), S(0, 0), S(0, 0)}},
+    // Knight
+    {{S(-50, -40), S(-30, -25), S(-20, -15), S(-15, -10)},
+     {S(-30, -25), S(-10, -10), S(0, -5), S(5, 0)},
+     {S(-20, -15), S(0, -5), S(10, 5), S(15, 10)},
+     {S(-15, -10), S(5, 0), S(15, 10), S(20, 15)},
+     {S(-15, -10), S(5, 0), S(15, 10), S(20, 15)},
+     {S(-20, -15), S(0, -5), S(10, 5), S(15, 10)},
+     {S(-30, -25), S(-10, -10), S(0, -5), S(5, 0)},
+     {S(-50, -40), S(-30, -25), S(-20, -15), S(-15, -10)}},
+    // Bishop
+    {{S(-20, -15), S(-5, -8), S(-10, -8), S(-5, -5)},
+     {S(-5, -8), S(10, 0), S(5, 0), S(5, 0)},
+     {S(-5, -5), S(5, 0), S(10, 5), S(10, 5)},
+     {S(-5, -5), S(5, 0), S(10, 5), S(15, 8)},
+     {S(-5, -5), S(5, 0), S(10, 5), S(15, 8)},
+     {S(-5, -5), S(5, 0), S(10, 5), S(10, 5)},
+     {S(-5, -8), S(0, 0), S(0, 0), S(0, 0)},
+     {S(-20, -15), S(-10, -8), S(-10, -8), S(-10, -5)}},
+    // Rook
+    {{S(-5, 0), S(0, 0), S(5, 0), S(8, 0)},
+     {S(-5, 0), S(0, 0), S(0, 0), S(0, 0)},
+     {S(-5, 0), S(0, 0), S(0, 0), S(0, 0)},
+     {S(-5, 0), S(0, 0), S(0, 0), S(0, 0)},
+     {S(-5, 0), S(0, 0), S(0, 0), S(0, 0)},
+     {S(-5, 0), S(0, 0), S(0, 0), S(0, 0)},
+     {S(10, 5), S(15, 5), S(15, 5), S(15, 5)},
+     {S(0, 0), S(0, 0), S(0, 0), S(5, 0)}},
+    // Queen
+    {{S(-10, -30), S(-5, -20), S(-5, -15), S(0, -10)},
+     {S(-5, -20), S(0, -10), S(0, -5), S(0, 0)},
+     {S(-5, -15), S(0, -5), S(3, 5), S(3, 10)},
+     {S(0, -10), S(0, 0), S(3, 10), S(5, 15)},
+     {S(0, -10), S(0, 0), S(3, 10), S(5, 15)},
+     {S(-5, -15), S(0, -5), S(3, 5), S(3, 10)},
+     {S(-5, -20), S(0, -10), S(0, -5), S(0, 0)},
+     {S(-10, -30), S(-5, -20), S(-5, -15), S(0, -10)}},
+    // King
+    {{S(30, -50), S(40, -30), S(10, -20), S(0, -15)},
+     {S(20, -30), S(20, -10), S(-10, 0), S(-20, 5)},
+     {S(-10, -20), S(-20, 0), S(-25, 10), S(-30, 15)},
+     {S(-20, -15), S(-30, 5), S(-35, 15), S(-40, 25)},
+     {S(-30, -15), S(-35, 5), S(-40, 15), S(-45, 25)},
+     {S(-35, -20), S(-40, 0), S(-45, 10), S(-50, 15)},
+     {S(-40, -30), S(-45, -10), S(-50, 0), S(-50, 5)},
+     {S(-50, -50), S(-50, -30), S(-50, -20), S(-50, -15)}},
+};
+
+#undef S
+
+struct Table {
+  Score psq[PIECE_NB][SQUARE_NB];
+};
+
+// Material plus bonus, from white's point of view, for every piece and square
+constexpr Table generate_table() {
+  Table table{};
+
+  for (int pt = PAWN; pt <= KING; ++pt)
+    for (int s = SQ_A1; s < SQUARE_NB; ++s) {
+      File f = file_of(Square(s));
+      File mirrored = f < FILE_E ? f : File(FILE_H - f);
+      Score score = PieceScore[pt] + Bonus[pt][rank_of(Square(s))][mirrored];
+
+      table.psq[piece_of(WHITE, PieceType(pt))][s] = score;
+      table.psq[piece_of(BLACK, PieceType(pt))][s ^ 56] = -score;
+    }
+
+  return table;
+}
+
+inline constexpr Table table = generate_table();
+
+inline constexpr auto& psq = table.psq;
+
+}  // namespace PSQT
+}  // namespace Juujfish
+
+#endif  // ifndef PSQT_H
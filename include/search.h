@@ -1,12 +1,15 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+#include <atomic>
+
 #include "bitboard.h"
 #include "evaluation.h"
 #include "heuristic.h"
 #include "movegen.h"
 #include "moveorder.h"
 #include "position.h"
+#include "timeman.h"
 #include "transposition.h"
 #include "types.h"
 
@@ -18,6 +21,26 @@ class ThreadPool;
 
 enum NodeType : uint8_t { RootNode, PV, NonPV };
 
+// Safety margin on top of the captured material for quiescence delta pruning
+constexpr Value DELTA_MARGIN = 200;
+
+// Per-depth SEE thresholds for shallow depth pruning in the main search
+constexpr Depth SEE_PRUNING_DEPTH = 8;
+constexpr Value SEE_CAPTURE_MARGIN = 180;
+constexpr Value SEE_QUIET_MARGIN = 30;
+
+// Null move pruning
+constexpr Depth NMP_MIN_DEPTH = 3;
+constexpr Depth NMP_BASE_REDUCTION = 3;
+constexpr Depth NMP_VERIFICATION_DEPTH = 12;
+
+// Late move reductions
+constexpr Depth LMR_MIN_DEPTH = 3;
+constexpr int LMR_HISTORY_DIVISOR = 16;
+
+// Nodes searched by the main thread between two checks of the limits
+constexpr int CHECK_TIME_INTERVAL = 512;
+
 #if 0
 namespace Search {
 class Worker {
@@ -86,6 +109,8 @@ using RootMoves = std::vector<RootMove>;
 
 namespace Search {
 
+void init();
+
 class Worker {
  public:
   Worker(ThreadPool& tp, size_t thread_id);
@@ -99,17 +124,25 @@ class Worker {
 
   // Temporary
   Move get_best_move() const;
-  int get_nodes() const { return nodes.load(std::memory_order_relaxed); }
+  std::uint64_t get_nodes() const {
+    return nodes.load(std::memory_order_relaxed);
+  }
 
  private:
   void iterative_deepening();
+  void check_time();
+
+  // UCI output of the main thread
+  std::vector<Move> principal_variation() const;
+  void print_info(Depth depth, Value score) const;
+  void print_best_move() const;
 
   template <NodeType Nt>
-  Value search(Position& pos, Value alpha, Value beta, Depth depth,
+  Value search(Position& pos, Value alpha, Value beta, Depth depth, int ply,
                bool cut_node);
 
-  // template <NodeType Nt>
-  // Value qsearch(Position& pos, Value alpha, Value beta);
+  template <NodeType Nt>
+  Value qsearch(Position& pos, Value alpha, Value beta, int ply);
 
   void copy_pv(Move* dest, const Move* src);
 
@@ -118,6 +151,14 @@ class Worker {
   Depth root_depth;
   RootMoves root_moves;
 
+  // Null move pruning is disabled below this ply during verification search
+  int nmp_min_ply;
+
+  // Search limits and time management (used by the main thread)
+  SearchLimits limits;
+  TimeManager tm;
+  int calls_cnt;
+
   // Pricipal variation
   Move pv[MAX_MOVES];
 
@@ -129,6 +170,10 @@ class Worker {
   HistoryHeuristic history;
   ButterflyHeuristic butterfly;
 
+  // Pawn structures and material evaluated by this thread
+  PawnTable pawn_table;
+  MaterialTable material_table;
+
   // Stats
   std::atomic<std::uint64_t> nodes;
 
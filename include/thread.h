@@ -1,6 +1,7 @@
 #ifndef THREAD_H
 #define THREAD_H
 
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <memory>
@@ -9,6 +10,7 @@
 #include "position.h"
 #include "search.h"
 #include "systhread.h"
+#include "timeman.h"
 #include "transposition.h"
 
 namespace Juujfish {
@@ -51,19 +53,29 @@ class ThreadPool {
   void clear();
   void set(int num_threads);
 
-  void start(Position& root_pos, StatesDequePtr& initial_states);
+  // The caller keeps ownership of the game states, they must outlive the search
+  void start(Position& root_pos, const StatesDequePtr& game_states,
+             const SearchLimits& limits);
   void start_searching();
 
   void wait_for_all_threads();
+  void wait_for_search_finished() { main_thread()->wait_for_search_finish(); }
+
+  std::uint64_t nodes_searched() const;
+
+  // Runs a job on one of the pool's threads outside of a search
+  void run_on_thread(size_t thread_id, std::function<void()> job);
+  void wait_on_thread(size_t thread_id);
+
+  inline size_t size() const { return threads.size(); }
 
   Thread* main_thread() { return threads.front().get(); }
 
-  std::atomic<bool> stop;
+  std::atomic<bool> stop, ponder, stop_on_ponderhit;
 
  private:
   std::vector<std::unique_ptr<Thread>> threads;
 
-  StatesDequePtr states;
   TranspositionTable* _tt;
 };
 
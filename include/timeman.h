@@ -0,0 +1,71 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "types.h"
+
+namespace Juujfish {
+
+using TimePoint = std::chrono::milliseconds::rep;
+
+inline TimePoint now() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+constexpr TimePoint MOVE_OVERHEAD = 10;  // Reserved for communication lag
+constexpr int DEFAULT_MOVES_TO_GO = 40;
+constexpr int MAX_TIME_RATIO = 4;  // Maximum time over optimum time
+
+// Limits of a search as given by the GUI, all times are in milliseconds
+struct SearchLimits {
+  SearchLimits() {
+    time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = 0;
+    movetime = start_time = 0;
+    movestogo = mate = 0;
+    depth = 0;
+    nodes = 0;
+    infinite = ponder = false;
+  }
+
+  inline bool use_time_management() const {
+    return time[WHITE] || time[BLACK];
+  }
+
+  TimePoint time[COLOR_NB];  // wtime, btime
+  TimePoint inc[COLOR_NB];   // winc, binc
+  TimePoint movetime;
+  TimePoint start_time;
+
+  int movestogo;
+  int mate;
+  Depth depth;
+  std::uint64_t nodes;
+  bool infinite, ponder;
+};
+
+/*
+  Computes the time budget of a search. The optimum time is the target spent
+  on a move when the search is stable, the maximum time is a hard limit that
+  is never exceeded even when the best move keeps changing.
+*/
+class TimeManager {
+ public:
+  void init(const SearchLimits& limits, Color us);
+
+  inline TimePoint optimum() const { return optimum_time; }
+  inline TimePoint maximum() const { return maximum_time; }
+  inline TimePoint elapsed() const { return now() - start_time; }
+
+ private:
+  TimePoint start_time;
+  TimePoint optimum_time;
+  TimePoint maximum_time;
+};
+
+}  // namespace Juujfish
+
+#endif  // ifndef TIMEMAN_H
@@ -1,8 +1,10 @@
 #ifndef TRANSPOSITION_H
 #define TRANSPOSITION_H
 
+#include <atomic>
 #include <iostream>
 
+#include "largepage.h"
 #include "search.h"
 #include "types.h"
 
@@ -12,136 +14,180 @@ struct TableEntry;
 struct TableData;
 struct TableWriter;
 
-constexpr size_t CACHE_LINE = 128;
-constexpr size_t BUCKET_SIZE = 8;
-constexpr size_t HASH_SIZE = 28;
+class ThreadPool;
 
-// 128 mb, must be a multiple of CACHE_LINE
-constexpr size_t TABLE_MEM_SIZE = 1 << HASH_SIZE;
+constexpr size_t CLUSTER_SIZE = 3;
+
+// Table sizes in MiB
+constexpr size_t DEFAULT_TABLE_MB = 256;
+constexpr size_t MAX_TABLE_MB = 1 << 25;
+
+// Depth of quiescence search entries. Depths are stored with an offset so
+// that a zero depth byte marks an empty entry.
+constexpr Depth DEPTH_QS = 0;
+constexpr Depth DEPTH_ENTRY_OFFSET = -1;
+
+// The age lives in the low 6 bits of the bound byte and wraps around
+constexpr uint8_t AGE_BITS = 6;
+constexpr uint8_t AGE_MASK = (1 << AGE_BITS) - 1;
 
 /*
-zobrist_key - 8 bytes
-second_key  - 2 bytes
-depth       - 1 byte
+Data word of an entry, read and written as one atomic 64-bit value:
+
+depth8      - 1 byte
 bound       - 2 bits
 age         - 6 bits
-score       - 2 bytes
-move        - 2 bytes
+move16      - 2 bytes
+value16     - 2 bytes
+eval16      - 2 bytes
 
-total       - 16 bytes
+The 16-bit key of the entry is stored separately, XORed with a 16-bit fold of
+the data word. A data word torn by two threads writing the same entry then no
+longer matches its key, so racy probes are rejected without any locking.
 */
 
 struct TableEntry {
  public:
-  TableEntry(TableEntry* entry) {
-    zobrist_key = entry->zobrist_key;
-    second_key = entry->second_key;
-    depth = entry->depth;
-    bound_age = entry->bound_age;
-    score = entry->score;
-    move = entry->move;
+  inline Depth get_depth() const { return Depth(depth8) + DEPTH_ENTRY_OFFSET; }
+  inline uint8_t get_age() const { return bound_age & AGE_MASK; }
+  inline Bound get_bound() const { return Bound(bound_age >> AGE_BITS); }
+  inline Value get_value() const { return value16; }
+  inline Value get_eval() const { return eval16; }
+  inline Move get_move() const { return Move(move16); }
+
+  inline bool is_occupied() const { return bool(depth8); }
+
+  // Fields from the low to the high bits of the data word, in the order of
+  // the layout above
+  static inline TableEntry unpack(uint64_t data) {
+    TableEntry entry;
+    entry.depth8 = uint8_t(data);
+    entry.bound_age = uint8_t(data >> 8);
+    entry.move16 = uint16_t(data >> 16);
+    entry.value16 = int16_t(uint16_t(data >> 32));
+    entry.eval16 = int16_t(uint16_t(data >> 48));
+    return entry;
   }
 
-  TableEntry() { memset(this, 0, sizeof(TableEntry)); }
-
-  inline Key get_zobrist() const { return zobrist_key; }
-  inline int8_t get_depth() const { return depth; }
-  inline uint8_t get_age() const { return bound_age & ((1 << 6) - 1); }
-  inline Bound get_bound() const { return Bound(bound_age >> 6); }
-  inline int16_t get_score() const { return score; }
-  inline Move get_move() const { return move; }
-
-  inline void clear() { memset(this, 0, sizeof(TableEntry)); }
-  inline bool is_occupied() const { return bool(depth); }
+  inline uint64_t pack() const {
+    return uint64_t(depth8) | uint64_t(bound_age) << 8 |
+           uint64_t(move16) << 16 | uint64_t(uint16_t(value16)) << 32 |
+           uint64_t(uint16_t(eval16)) << 48;
+  }
 
-  void save(Key zobrist_key, uint16_t second_key, int8_t depth, Bound b,
-            uint8_t age, int16_t score, Move m);
+  static inline uint16_t fold(uint64_t data) {
+    return uint16_t(data ^ (data >> 16) ^ (data >> 32) ^ (data >> 48));
+  }
 
-  friend struct TableBucket;
+  friend struct TableWriter;
 
  private:
-  Key zobrist_key;
-  uint16_t second_key;
-
-  int8_t depth;
-
+  uint8_t depth8;
   uint8_t bound_age;
-  int16_t score;
-
-  Move move;
+  uint16_t move16;
+  int16_t value16;
+  int16_t eval16;
 };
 
-struct TableData {
-  TableData(TableEntry* entry)
-      : zobrist_key(entry->get_zobrist()),
-        depth(entry->get_depth()),
-        bound(entry->get_bound()),
-        score(entry->get_score()),
-        move(entry->get_move()) {}
+static_assert(sizeof(TableEntry) == sizeof(uint64_t),
+              "Error: TableEntry must fit in a data word");
 
-  Key zobrist_key;
+struct TableData {
+  TableData(const TableEntry& entry)
+      : depth(entry.get_depth()),
+        bound(entry.get_bound()),
+        value(entry.get_value()),
+        eval(entry.get_eval()),
+        move(entry.get_move()) {}
 
-  int8_t depth;
+  Depth depth;
 
   Bound bound;
-  int16_t score;
+  Value value;
+  Value eval;
 
   Move move;
 };
 
+// Three keys, padding and three data words fill 32 bytes, so a cluster never
+// spans two cache lines and a probe touches exactly one
+struct TableCluster {
+  std::atomic<uint16_t> keys[CLUSTER_SIZE];
+  uint16_t padding;
+  std::atomic<uint64_t> data[CLUSTER_SIZE];
+};
+
+static_assert(sizeof(TableCluster) == 32,
+              "Error: TableCluster must be 32 bytes");
+
 struct TableWriter {
  public:
-  TableWriter(TableEntry* entry, uint8_t age) {
-    this->entry = entry;
+  TableWriter(TableCluster* cluster, size_t index, uint8_t age) {
+    this->cluster = cluster;
+    this->index = index;
     this->age = age;
   }
 
-  inline void write(Key zobrist_key, uint16_t second_key, int8_t depth, Bound b,
-                    int16_t score, Move m) {
-    entry->save(zobrist_key, second_key, depth, b, age, score, m);
-  }
+  void write(Key zobrist_key, Depth depth, Bound b, Value value, Value eval,
+             Move m);
 
  private:
-  TableEntry* entry;
+  TableCluster* cluster;
+  size_t index;
   uint8_t age;
 };
 
-struct TableBucket {
-  TableBucket() { memset(entries, 0, sizeof(TableEntry) * BUCKET_SIZE); }
-  size_t find_index(Key zobrist_key, uint16_t second_key) const;
-
-  TableEntry entries[BUCKET_SIZE];
-};
-
 class TranspositionTable {
  public:
-  ~TranspositionTable() { delete[] table; }
+  ~TranspositionTable() { free(); }
 
-  inline void init() {
-    bucket_count = TABLE_MEM_SIZE / (BUCKET_SIZE * sizeof(TableEntry));
-    table = new (std::align_val_t(CACHE_LINE)) TableBucket[bucket_count];
+  // Reallocates the table to the given size in MiB and clears it
+  void resize(size_t mb, ThreadPool& threads);
 
-    table_age = 0;
-  }
+  // Zeroes the table, split in one slice per thread of the pool
+  void clear(ThreadPool& threads);
 
-  inline void clear() { memset(table, 0, TABLE_MEM_SIZE); }
-  inline void new_search() { table_age++; }
+  inline void new_search() { table_age = (table_age + 1) & AGE_MASK; }
   inline uint8_t get_age() const { return table_age; }
 
   inline uint8_t relative_age(uint8_t entry_age) const {
-    return table_age - entry_age;
+    return (table_age - entry_age) & AGE_MASK;
+  }
+
+  // Entries with the lowest value are replaced first, every search of age
+  // costs as much as 8 plies of depth
+  inline int replacement_value(const TableEntry& entry) const {
+    return entry.get_depth() - 8 * relative_age(entry.get_age());
   }
 
-  std::tuple<bool, TableData, TableWriter> probe(Key zobrist_key,
-                                                 uint16_t second_key) const;
+  std::tuple<bool, TableData, TableWriter> probe(Key zobrist_key) const;
+
+  // Starts loading the cluster of a key into the cache ahead of its probe
+  inline void prefetch(Key zobrist_key) const {
+    __builtin_prefetch(&table[cluster_index(zobrist_key)]);
+  }
+
+  inline size_t size_mb() const {
+    return cluster_count * sizeof(TableCluster) >> 20;
+  }
+  inline LargePageMode page_mode() const { return large_page_mode; }
 
  private:
-  size_t bucket_count;
-  TableBucket* table;
+  void free();
+
+  // Maps a key uniformly onto [0, cluster_count) with a multiply-high, so that
+  // the cluster count does not have to be a power of two
+  inline size_t cluster_index(Key zobrist_key) const {
+    return (unsigned __int128)zobrist_key * cluster_count >> 64;
+  }
+
+  size_t cluster_count = 0;
+  TableCluster* table = nullptr;
+  LargePageMode large_page_mode = NORMAL_PAGES;
 
-  uint8_t table_age;
+  uint8_t table_age = 0;
 };
 
 }  // namespace Juujfish
 
-#endif  // ifndef TRANSPOSITION_H
\ No newline at end of file
+#endif  // ifndef TRANSPOSITION_H
@@ -2,7 +2,6 @@
 #define TYPES_H
 
 #include <cstdint>
-#include <random>
 
 namespace Juujfish {
 
@@ -176,7 +175,7 @@ inline Square& operator--(Square& s) {
 
 enum Color { WHITE, BLACK, COLOR_NB };
 
-inline Color operator~(Color c) {
+constexpr Color operator~(Color c) {
   return Color(c ^ 1);
 }
 
@@ -235,9 +234,11 @@ constexpr Value KING_VALUE = 20000;
 
 constexpr Value VALUE_ZERO = 0;
 constexpr Value VALUE_DRAW = 0;
+constexpr Value VALUE_KNOWN_WIN = 10000;
 constexpr Value VALUE_MATE = 30000;
 constexpr Value VALUE_INFINITE = 32001;
 constexpr Value VALUE_SEARCH_ABORTED = 32002;
+constexpr Value VALUE_NONE = 32003;
 
 enum PieceType {
   NO_PIECE_TYPE = -1,
@@ -253,6 +254,51 @@ enum PieceType {
 constexpr Value PieceValue[] = {PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE,
                                 ROOK_VALUE, QUEEN_VALUE,  KING_VALUE};
 
+// Game phase, from MAX_PHASE with all pieces on the board down to 0 with only
+// kings and pawns left
+constexpr int PiecePhase[] = {0, 1, 1, 2, 4, 0};
+constexpr int MAX_PHASE = 24;
+
+/*
+  A middlegame and an endgame value packed in one integer, the endgame value
+  in the upper 16 bits, so that both are added and subtracted at once. The
+  evaluation interpolates between the two by the game phase.
+*/
+enum Score : int { SCORE_ZERO };
+
+constexpr Score make_score(int mg, int eg) {
+  return Score(int(static_cast<unsigned int>(eg) << 16) + mg);
+}
+
+// The endgame value is rounded so that a negative middlegame value, which
+// borrows from the upper half, is compensated
+constexpr Value eg_value(Score s) {
+  return Value(std::int16_t(std::uint16_t(unsigned(s + 0x8000) >> 16)));
+}
+
+constexpr Value mg_value(Score s) {
+  return Value(std::int16_t(std::uint16_t(unsigned(s))));
+}
+
+constexpr Score operator+(Score s1, Score s2) {
+  return Score(int(s1) + int(s2));
+}
+constexpr Score operator-(Score s1, Score s2) {
+  return Score(int(s1) - int(s2));
+}
+constexpr Score operator-(Score s) {
+  return Score(-int(s));
+}
+constexpr Score operator*(Score s, int i) {
+  return Score(int(s) * i);
+}
+inline Score& operator+=(Score& s1, Score s2) {
+  return s1 = s1 + s2;
+}
+inline Score& operator-=(Score& s1, Score s2) {
+  return s1 = s1 - s2;
+}
+
 enum Piece {
   NO_PIECE = -1,
   W_PAWN,
@@ -280,7 +326,8 @@ constexpr PieceType type_of(Piece p) {
   return PieceType(int(p) & 7);
 }
 
-using Depth = uint8_t;
+// Signed so that reductions may take the remaining depth below zero
+using Depth = int;
 
 enum MoveType {
   NORMAL,
@@ -324,12 +371,22 @@ class Move {
 
 using Key = std::uint64_t;
 
-inline Key random_key() {
-  std::random_device rd;
-  std::mt19937_64 gen(rd());
-  std::uniform_int_distribution<uint64_t> dist(0, UINT64_MAX);
-  return dist(gen);
-}
+// xorshift64* pseudo random number generator. It can run in constant
+// expressions, so tables of random keys can be built at compile time.
+class PRNG {
+ public:
+  constexpr explicit PRNG(std::uint64_t seed) : s(seed) {}
+
+  constexpr Key rand64() {
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 2685821657736338717ULL;
+  }
+
+ private:
+  std::uint64_t s;  // Must not be zero
+};
 
 const uint8_t MAX_PLY = 128;  // max depth of search
 
@@ -0,0 +1,72 @@
+#ifndef UCI_H
+#define UCI_H
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "position.h"
+#include "thread.h"
+#include "transposition.h"
+#include "types.h"
+
+namespace Juujfish {
+
+constexpr const char* ENGINE_NAME = "Juujfish";
+constexpr const char* ENGINE_AUTHOR = "the Juujfish developers";
+
+constexpr const char* START_FEN =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+constexpr int DEFAULT_UCI_THREADS = 1;
+constexpr int MAX_UCI_THREADS = 256;
+
+namespace UCI {
+
+// Formats a score as "cp <x>" or "mate <y>" from the side to move's view
+std::string value(Value v);
+
+// Formats a move in coordinate notation, the null move is "0000"
+std::string move(Move m);
+
+}  // namespace UCI
+
+/*
+  Universal Chess Interface front end. Commands are read on the calling thread
+  while the search runs asynchronously on the thread pool, so that stop and
+  ponderhit are served immediately. The game's StateInfo deque is owned here
+  and extended incrementally when a position command only appends moves to
+  the previous one.
+*/
+class UCIEngine {
+ public:
+  UCIEngine();
+  ~UCIEngine();
+
+  // Runs the command loop, or the command line arguments as a single command
+  void loop(int argc, char* argv[]);
+
+ private:
+  void position(std::istringstream& is);
+  void go(std::istringstream& is);
+  void setoption(std::istringstream& is);
+  void new_game();
+
+  // Searches the bench positions to a fixed depth: bench [hash] [threads]
+  // [depth]
+  void bench(std::istringstream& is);
+
+  TranspositionTable tt;
+  ThreadPool threads;
+
+  Position pos;
+  StatesDequePtr states;
+
+  // Last position command, used to only replay the newly appended moves
+  std::string game_fen;
+  std::vector<std::string> game_moves;
+};
+
+}  // namespace Juujfish
+
+#endif  // ifndef UCI_H
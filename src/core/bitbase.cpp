@@ -0,0 +1,133 @@
+#include <bitset>
+#include <vector>
+
+#include "endgame.h"
+
+namespace Juujfish {
+
+namespace {
+
+// White king, black king, side to move and a pawn on the a- to d-file of the
+// second to seventh rank
+constexpr unsigned MAX_INDEX = 2 * 24 * 64 * 64;
+
+std::bitset<MAX_INDEX> KPKBitbase;
+
+unsigned index(Color side_to_move, Square bksq, Square wksq, Square psq) {
+  return int(wksq) | (bksq << 6) | (side_to_move << 12) |
+         (file_of(psq) << 13) | ((RANK_7 - rank_of(psq)) << 15);
+}
+
+enum Result { INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4 };
+
+inline Result& operator|=(Result& r1, Result r2) {
+  return r1 = Result(r1 | r2);
+}
+
+struct KPKPosition {
+  KPKPosition() = default;
+  explicit KPKPosition(unsigned idx);
+
+  Result classify(const std::vector<KPKPosition>& db);
+
+  Color side_to_move;
+  Square ksq[COLOR_NB];
+  Square psq;
+  Result result;
+};
+
+KPKPosition::KPKPosition(unsigned idx) {
+  ksq[WHITE] = Square(idx & 0x3F);
+  ksq[BLACK] = Square((idx >> 6) & 0x3F);
+  side_to_move = Color((idx >> 12) & 0x01);
+  psq = square_of(File((idx >> 13) & 0x03),
+                  Rank(RANK_7 - ((idx >> 15) & 0x07)));
+
+  Square push = psq + NORTH;
+
+  // Overlapping pieces, touching kings, or black in check with white to move
+  if (distance(ksq[WHITE], ksq[BLACK]) <= 1 || ksq[WHITE] == psq ||
+      ksq[BLACK] == psq ||
+      (side_to_move == WHITE && (pawn_attacks_bb(WHITE, psq) & ksq[BLACK])))
+    result = INVALID;
+
+  // The pawn promotes without being captured
+  else if (side_to_move == WHITE && rank_of(psq) == RANK_7 &&
+           ksq[WHITE] != push && ksq[BLACK] != push &&
+           (distance(ksq[BLACK], push) > 1 ||
+            (attacks_bb(ksq[WHITE], KING) & push)))
+    result = WIN;
+
+  // Stalemate, or the pawn is taken without being defended
+  else if (side_to_move == BLACK &&
+           (!(attacks_bb(ksq[BLACK], KING) &
+              ~(attacks_bb(ksq[WHITE], KING) | pawn_attacks_bb(WHITE, psq))) ||
+            (attacks_bb(ksq[BLACK], KING) & ~attacks_bb(ksq[WHITE], KING) &
+             psq)))
+    result = DRAW;
+
+  else
+    result = UNKNOWN;
+}
+
+// A position is won for white if one white move leads to a win, or if all
+// black moves do, and drawn the other way round. Until then it stays unknown.
+Result KPKPosition::classify(const std::vector<KPKPosition>& db) {
+  const Color us = side_to_move;
+  const Color them = ~us;
+  const Result good = us == WHITE ? WIN : DRAW;
+  const Result bad = us == WHITE ? DRAW : WIN;
+
+  Result r = INVALID;
+  BitBoard b = attacks_bb(ksq[us], KING);
+
+  while (b) {
+    Square s = lsb(pop_lsb(b));
+    r |= us == WHITE ? db[index(them, ksq[BLACK], s, psq)].result
+                     : db[index(them, s, ksq[WHITE], psq)].result;
+  }
+
+  if (us == WHITE) {
+    Square push = psq + NORTH;
+
+    // Pushes to the eighth rank are handled when the position is created
+    if (rank_of(psq) < RANK_7)
+      r |= db[index(them, ksq[BLACK], ksq[WHITE], push)].result;
+
+    if (rank_of(psq) == RANK_2 && push != ksq[WHITE] && push != ksq[BLACK])
+      r |= db[index(them, ksq[BLACK], ksq[WHITE], push + NORTH)].result;
+  }
+
+  return result = r & good ? good : r & UNKNOWN ? UNKNOWN : bad;
+}
+
+}  // namespace
+
+void Bitbases::init() {
+  std::vector<KPKPosition> db(MAX_INDEX);
+
+  for (unsigned idx = 0; idx < MAX_INDEX; ++idx)
+    db[idx] = KPKPosition(idx);
+
+  // Iterate until no unknown position can be resolved any further, what is
+  // left is a draw
+  bool repeat = true;
+  while (repeat) {
+    repeat = false;
+    for (unsigned idx = 0; idx < MAX_INDEX; ++idx)
+      repeat |= db[idx].result == UNKNOWN && db[idx].classify(db) != UNKNOWN;
+  }
+
+  for (unsigned idx = 0; idx < MAX_INDEX; ++idx)
+    if (db[idx].result == WIN)
+      KPKBitbase.set(idx);
+}
+
+bool Bitbases::probe(Square wksq, Square wpsq, Square bksq,
+                     Color side_to_move) {
+  assert(file_of(wpsq) <= FILE_D);
+
+  return KPKBitbase[index(side_to_move, bksq, wksq, wpsq)];
+}
+
+}  // namespace Juujfish
@@ -1,5 +1,4 @@
 #include <iostream>
-#include <vector>
 
 #include "bitboard.h"
 
@@ -15,6 +14,59 @@ BitBoard RaysBB[SQUARE_NB][DIRECTIONS_NB];
 
 alignas(64) Magic Magics[SQUARE_NB][2];
 
+/*
+  Known good magics, indexed by square. They were found once by a trial and
+  error search over sparse candidates from a fixed-seed xorshift generator,
+  so that startup only has to fill the attack tables.
+*/
+constexpr BitBoard BishopMagics[SQUARE_NB] = {
+    0x10102002004A1420ULL, 0x0020010224910040ULL, 0x4090008A00C0288CULL,
+    0x0008218124020100ULL, 0x4002021000100000ULL, 0x8C01100210802300ULL,
+    0x80140A0104221010ULL, 0x484010880B082002ULL, 0x0A035A1808008401ULL,
+    0x4030200404A18102ULL, 0x4180040800890080ULL, 0x9B51A40409801400ULL,
+    0x3000040420002002ULL, 0x2200608805402048ULL, 0x00660201822030C6ULL,
+    0x0000288048029000ULL, 0x100500A08C100200ULL, 0x0204000810040050ULL,
+    0x04B4000814240010ULL, 0x404200040A120010ULL, 0x020C000081A06004ULL,
+    0x8811900600500801ULL, 0x8100C00C07041042ULL, 0x0011221100823040ULL,
+    0x1042883840100402ULL, 0x2088424020020204ULL, 0x0000480410022141ULL,
+    0x1010040000440008ULL, 0x5004044014010044ULL, 0x003001008020880CULL,
+    0x0488388002220100ULL, 0x002A004008804805ULL, 0x0404200822A02A00ULL,
+    0x4108040202048850ULL, 0x1804260101080800ULL, 0x0000202020080080ULL,
+    0x8204090200100808ULL, 0x02010AC500160110ULL, 0x0402121208140490ULL,
+    0x1001840083010190ULL, 0x1182412020000800ULL, 0x0021041084069200ULL,
+    0x0141004030040204ULL, 0x0000002018003500ULL, 0x0110541018884400ULL,
+    0x200400908201E102ULL, 0x00208A2081000203ULL, 0x04810B2402800112ULL,
+    0x2000882108A00140ULL, 0x0000221202A0040CULL, 0x04800AB308080040ULL,
+    0x0000400121881008ULL, 0x0000006042441408ULL, 0x2405189005220140ULL,
+    0x00B014100408D220ULL, 0x4708890102020688ULL, 0x0800A90110012001ULL,
+    0x181002C228230800ULL, 0x400A011421080800ULL, 0x0000002840608804ULL,
+    0x0403004860204102ULL, 0x8004002404080200ULL, 0x0000200610810100ULL,
+    0x002C20008D010100ULL};
+
+constexpr BitBoard RookMagics[SQUARE_NB] = {
+    0x4080028040002412ULL, 0x04401002A0004000ULL, 0x0080200090020880ULL,
+    0x8180048008011000ULL, 0x0100080010050002ULL, 0x020008A110120004ULL,
+    0x9100010004288200ULL, 0x2100010000218052ULL, 0x0000800080B44004ULL,
+    0x2A09002302400184ULL, 0x0009001102A00040ULL, 0x0001002090040900ULL,
+    0x0008800400880080ULL, 0x080A001014884200ULL, 0x0424001A30040948ULL,
+    0x040100008061000AULL, 0x1040018000204880ULL, 0xD005404000201000ULL,
+    0x0007050040200050ULL, 0x000122000A001040ULL, 0x0806020010201804ULL,
+    0xC102808042001400ULL, 0x02401C0002080110ULL, 0x0020020021004484ULL,
+    0x4009C00080008020ULL, 0x0011008500400960ULL, 0x004500C300102000ULL,
+    0x8490008080280050ULL, 0x0050840080800800ULL, 0x0004040080800200ULL,
+    0x2000888400021001ULL, 0x2018848200004421ULL, 0x0000804000800832ULL,
+    0x0030042018400040ULL, 0x8024423202002382ULL, 0x3051100081802800ULL,
+    0x4006640080804800ULL, 0x000D802A00802400ULL, 0x0041080224008910ULL,
+    0x0812440082003041ULL, 0x0100884016608000ULL, 0x4060004000828028ULL,
+    0x08A0030210410020ULL, 0x0000080010008080ULL, 0x8108048801010010ULL,
+    0x008A001804220010ULL, 0x0020C81E41340050ULL, 0x9000040040920001ULL,
+    0x60800420014011C0ULL, 0x0200C30208208200ULL, 0x2604116005410100ULL,
+    0x0880300080080080ULL, 0x8200040058008180ULL, 0x01000400803A0080ULL,
+    0x100801104208A400ULL, 0x0001000140820300ULL, 0x2108104900800061ULL,
+    0x000420C002110289ULL, 0x04CA9A0280401022ULL, 0x0200890430010021ULL,
+    0x0342000448112062ULL, 0x0021002400181601ULL, 0x3000104091020804ULL,
+    0x0801002043040082ULL};
+
 void BitBoards::init() {
 
   init_magics();
@@ -58,58 +110,30 @@ void BitBoards::init() {
 }
 
 void init_magics() {
-  int sliding_attacks_index = 0;
-  for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-    struct Magic m = find_magic(s, BISHOP, sliding_attacks_index);
-    Magics[s][BISHOP - BISHOP] = m;
-    sliding_attacks_index += (1 << m.shift);
-  }
-  for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-    struct Magic m = find_magic(s, ROOK, sliding_attacks_index);
-    Magics[s][ROOK - BISHOP] = m;
-    sliding_attacks_index += (1 << m.shift);
-  }
-}
-
-Magic find_magic(Square s, PieceType pt, int sliding_attacks_index) {
-
-  std::vector<BitBoard> blocker_bitboards = generate_blocker_bitboards(s, pt);
-  std::vector<BitBoard> attacks_vec;
-
-  BitBoard mask = generate_movement_mask(s, pt);
-
-  for (BitBoard bb : blocker_bitboards) {
-    attacks_vec.push_back(generate_sliding_attacks(s, pt, bb));
-  }
-
-  int shift = popcount(mask);
-
-  struct Magic magic;
-  magic.mask = mask;
-  magic.shift = shift;
-  magic.attacks = SlidingAttacks + sliding_attacks_index;
-
-  while (true) {
-    magic.magic = random_magic_candidate();
-    if (try_magic(magic, blocker_bitboards, attacks_vec))
-      break;
-  }
-  return magic;
-}
-
-bool try_magic(Magic& magic, std::vector<BitBoard>& blocker_bitboards,
-               std::vector<BitBoard>& attacks_vec) {
-  std::fill(magic.attacks, magic.attacks + (1 << magic.shift), 0);
-  for (size_t idx = 0; idx < blocker_bitboards.size(); ++idx) {
-    BitBoard bb = blocker_bitboards[idx];
-    BitBoard attack = attacks_vec[idx];
-    unsigned index = magic.index(bb);
-    if (magic.attacks[index] != 0 && magic.attacks[index] != attack) {
-      return false;
+  BitBoard* attacks = SlidingAttacks;
+
+  for (PieceType pt : {BISHOP, ROOK}) {
+    for (Square s = SQ_A1; s <= SQ_H8; ++s) {
+      Magic& m = Magics[s][pt - BISHOP];
+
+      m.mask = generate_movement_mask(s, pt);
+      m.shift = popcount(m.mask);
+      m.magic = pt == BISHOP ? BishopMagics[s] : RookMagics[s];
+      m.attacks = attacks;
+
+      // Carry-rippler walk over every subset of the mask
+      BitBoard occupied = 0;
+      do {
+        m.attacks[m.index(occupied)] =
+            generate_sliding_attacks(s, pt, occupied);
+        occupied = (occupied - m.mask) & m.mask;
+      } while (occupied);
+
+      attacks += 1 << m.shift;
     }
-    magic.attacks[index] = attack;
   }
-  return true;
+
+  assert(attacks == SlidingAttacks + 0x1A480);
 }
 
 BitBoard generate_sliding_attacks(Square s, PieceType pt, BitBoard occupied) {
@@ -144,32 +168,4 @@ BitBoard generate_movement_mask(Square s, PieceType pt) {
   }
   return movement_mask;
 }
-
-std::vector<BitBoard> generate_blocker_bitboards(Square s, PieceType pt) {
-  BitBoard movement_mask = generate_movement_mask(s, pt);
-
-  std::vector<uint64_t> blocker_bitboards;
-
-  std::vector<int> bit_positions;
-  for (int i = 0; i < 64; i++) {
-    if (movement_mask & (1ULL << i)) {
-      bit_positions.push_back(i);
-    }
-  }
-
-  int num_bits = bit_positions.size();
-  int num_combinations = 1 << num_bits;
-
-  for (int i = 0; i < num_combinations; i++) {
-    uint64_t blocker = 0;
-    for (int j = 0; j < num_bits; j++) {
-      if (i & (1 << j)) {
-        blocker |= (1ULL << bit_positions[j]);
-      }
-    }
-    blocker_bitboards.push_back(blocker);
-  }
-
-  return blocker_bitboards;
-}
 }  // namespace Juujfish
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include <algorithm>
+
+#include "endgame.h"
+#include "movegen.h"
+
+namespace Juujfish {
+
+namespace {
+
+// Drives the weak king to the edge of the board
+int push_to_edge(Square s) {
+  int rd = std::min(int(rank_of(s)), RANK_8 - rank_of(s));
+  int fd = std::min(int(file_of(s)), FILE_H - file_of(s));
+  return 90 - (7 * fd * fd / 2 + 7 * rd * rd / 2);
+}
+
+// Drives the weak king to the a1 or h8 corner
+int push_to_corner(Square s) {
+  return std::abs(7 - rank_of(s) - file_of(s));
+}
+
+// Brings the strong king next to the weak one
+int push_close(Square s1, Square s2) {
+  return 140 - 20 * distance(s1, s2);
+}
+
+// Mirrors the position so that the strong side is white with the pawn, if
+// any, on the a- to d-file
+Square normalize(const Position& pos, Color strong_side, Square s) {
+  if (strong_side == BLACK)
+    s = Square(int(s) ^ 56);
+
+  BitBoard pawns = pos.pieces(strong_side, PAWN);
+  if (pawns && file_of(lsb(pawns)) >= FILE_E)
+    s = Square(int(s) ^ 7);
+
+  return s;
+}
+
+// The lone king of the weak side has no legal move and is not in check
+bool is_stalemate(const Position& pos, Color weak_side) {
+  return pos.get_side_to_move() == weak_side && !pos.is_in_check() &&
+         MoveList<LEGAL>(pos).size() == 0;
+}
+
+}  // namespace
+
+Value Endgames::KRK(const Position& pos, Color strong_side) {
+  Square strong_king = lsb(pos.pieces(strong_side, KING));
+  Square weak_king = lsb(pos.pieces(~strong_side, KING));
+  Square rook = lsb(pos.pieces(strong_side, ROOK));
+
+  if (is_stalemate(pos, ~strong_side))
+    return VALUE_DRAW;
+
+  // The weak king takes the undefended rook
+  if (pos.get_side_to_move() != strong_side && distance(weak_king, rook) == 1 &&
+      distance(strong_king, rook) > 1)
+    return VALUE_DRAW;
+
+  return VALUE_KNOWN_WIN + ROOK_VALUE + push_to_edge(weak_king) +
+         push_close(strong_king, weak_king);
+}
+
+// Only the corners of the bishop's color can be mated in, so the weak king is
+// driven there rather than to the nearest edge
+Value Endgames::KBNK(const Position& pos, Color strong_side) {
+  Square strong_king = lsb(pos.pieces(strong_side, KING));
+  Square weak_king = lsb(pos.pieces(~strong_side, KING));
+  Square bishop = lsb(pos.pieces(strong_side, BISHOP));
+
+  if (is_stalemate(pos, ~strong_side))
+    return VALUE_DRAW;
+
+  // With a light squared bishop the a8 and h1 corners are the targets
+  if (opposite_colors(bishop, SQ_A1))
+    weak_king = Square(int(weak_king) ^ 7);
+
+  return VALUE_KNOWN_WIN + KNIGHT_VALUE + BISHOP_VALUE +
+         push_close(strong_king, weak_king) + 50 * push_to_corner(weak_king);
+}
+
+Value Endgames::KPK(const Position& pos, Color strong_side) {
+  Square strong_king =
+      normalize(pos, strong_side, lsb(pos.pieces(strong_side, KING)));
+  Square pawn =
+      normalize(pos, strong_side, lsb(pos.pieces(strong_side, PAWN)));
+  Square weak_king =
+      normalize(pos, strong_side, lsb(pos.pieces(~strong_side, KING)));
+  Color us = pos.get_side_to_move() == strong_side ? WHITE : BLACK;
+
+  if (!Bitbases::probe(strong_king, pawn, weak_king, us))
+    return VALUE_DRAW;
+
+  return VALUE_KNOWN_WIN + PAWN_VALUE + rank_of(pawn);
+}
+
+int Endgames::opposite_bishops(const Position& pos, const PawnEntry* pawns,
+                               Color strong_side) {
+  if (!opposite_colors(lsb(pos.pieces(WHITE, BISHOP)),
+                       lsb(pos.pieces(BLACK, BISHOP))))
+    return SCALE_FACTOR_NONE;
+
+  // With only the bishops left even two pawns up is often a draw, other
+  // pieces give the strong side more winning chances
+  if (pos.non_pawn_material(WHITE) == BISHOP_VALUE &&
+      pos.non_pawn_material(BLACK) == BISHOP_VALUE)
+    return 16 + 4 * popcount(pawns->passed(strong_side));
+
+  return std::min(22 + 3 * popcount(pos.pieces(strong_side)),
+                  SCALE_FACTOR_NORMAL);
+}
+
+}  // namespace Juujfish
@@ -1,205 +1,151 @@
-#include <cmath>
-
 #include "evaluation.h"
 
+#include "nnue.h"
+
 namespace Juujfish {
 
-Phase get_game_phase(Position& pos) {
-  int major_minor_cnt = popcount(pos.pieces(KNIGHT) | pos.pieces(BISHOP) |
-                                 pos.pieces(ROOK) | pos.pieces(QUEEN));
-
-  if (major_minor_cnt <= 6) {
-    return ENDGAME;
-  } else if (major_minor_cnt <= 10) {
-    return MIDDLEGAME;
-  } else {
-    for (Color c : {WHITE, BLACK}) {
-      BitBoard backrank = c == WHITE ? RANK_1_BB : RANK_8_BB;
-      backrank &= ~(pos.pieces(c, ROOK) | pos.pieces(c, KING));
-      if (!(backrank))
-        return MIDDLEGAME;
-    }
-    return OPENING;
+Value evaluate(Position& pos, PawnTable& pawn_table,
+               MaterialTable& material_table) {
+  MaterialEntry* me = material_table.probe(pos);
+
+  // Known endings are evaluated exactly, with or without a network
+  if (me->has_endgame())
+    return me->evaluate(pos);
+
+  if (NNUE::is_loaded()) {
+    Value v = NNUE::evaluate(pos);
+    return pos.get_side_to_move() == WHITE ? v : -v;
   }
-}
 
-Value evaluate(Position& pos) {
-  Phase p = get_game_phase(pos);
-  Value score =
-      p == OPENING
-          ? (evaluate<WHITE, OPENING>(pos) - evaluate<BLACK, OPENING>(pos))
-      : p == MIDDLEGAME
-          ? (evaluate<WHITE, MIDDLEGAME>(pos) -
-             evaluate<BLACK, MIDDLEGAME>(pos))
-          : (evaluate<WHITE, ENDGAME>(pos) - evaluate<BLACK, ENDGAME>(pos));
+  EvalInfo ei;
 
-  return score;
-}
+  ei.pawns = pawn_table.probe(pos);
 
-template <Color C, Phase P>
-Value evaluate(Position& pos) {
-  return (score_material<C, P>(pos) + score_king_safety<C, P>(pos) +
-          score_pawns<C, P>(pos));
-}
+  init_eval_info<WHITE>(pos, ei);
+  init_eval_info<BLACK>(pos, ei);
 
-template <Color C, Phase P>
-Value score_material(Position& pos) {
-  Value score = 0;
-  double center_phase_multiplier = 0;
-  double phase_multiplier = 0;
+  Score score =
+      pos.get_psq_score() + me->get_imbalance() + ei.pawns->pawn_score();
 
-  BitBoard pawns = pos.pieces(C, PAWN);
-  BitBoard knights = pos.pieces(C, KNIGHT);
-  BitBoard bishops = pos.pieces(C, BISHOP);
-  BitBoard rooks = pos.pieces(C, ROOK);
-  BitBoard queens = pos.pieces(C, QUEEN);
+  // The attack maps are complete once all pieces have been scored
+  score += score_pieces<WHITE, KNIGHT>(pos, ei) -
+           score_pieces<BLACK, KNIGHT>(pos, ei);
+  score += score_pieces<WHITE, BISHOP>(pos, ei) -
+           score_pieces<BLACK, BISHOP>(pos, ei);
+  score += score_pieces<WHITE, ROOK>(pos, ei) -
+           score_pieces<BLACK, ROOK>(pos, ei);
+  score += score_pieces<WHITE, QUEEN>(pos, ei) -
+           score_pieces<BLACK, QUEEN>(pos, ei);
 
-  Square king_sq = lsb(pos.pieces(C, KING));
+  score +=
+      score_king_safety<WHITE>(pos, ei) - score_king_safety<BLACK>(pos, ei);
+  score += score_threats<WHITE>(pos, ei) - score_threats<BLACK>(pos, ei);
 
-  BitBoard occ = pos.pieces();
+  Color strong_side = eg_value(score) > VALUE_ZERO ? WHITE : BLACK;
 
-  score += (int)(0.8 * PAWN_VALUE * popcount(pawns));
-  score += (int)(0.6 * KNIGHT_VALUE * popcount(knights));
-  score += (int)(0.6 * BISHOP_VALUE * popcount(bishops));
-  score += (int)(0.6 * ROOK_VALUE * popcount(rooks));
-  score += (int)(0.6 * QUEEN_VALUE * popcount(queens));
-  score += KING_VALUE;
+  return taper(score, pos.get_phase(),
+               me->scale_factor(pos, ei.pawns, strong_side));
+}
 
-  // Pawns:
-  center_phase_multiplier = (P == OPENING) ? 2 : ((P == MIDDLEGAME) ? 1 : 0);
+template <Color C>
+void init_eval_info(Position& pos, EvalInfo& ei) {
+  constexpr Direction DOWN = C == WHITE ? SOUTH : NORTH;
 
-  while (pawns) {
-    Square pawn_sq = lsb(pop_lsb(pawns));
-    BitBoard pawn_attack = pawn_attacks_bb(C, pawn_sq);
+  BitBoard blocked_pawns = pos.pieces(C, PAWN) & shift<DOWN>(pos.pieces());
 
-    score += (int)(0.1 * PAWN_VALUE * popcount(pawn_attack));
+  ei.king_zone[C] = attacks_bb(lsb(pos.pieces(C, KING)), KING);
 
-    score += center_phase_multiplier * OUTER_CENTER_BONUS *
-             popcount(OUTER_CENTER & pawn_sq);
-    score += center_phase_multiplier * INNER_CENTER_BONUS *
-             popcount(INNER_CENTER & pawn_sq);
-  }
+  ei.attacked_by[C][PAWN] = pawn_attacks_bb(C, pos.pieces(C, PAWN));
+  ei.attacked_by[C][KING] = ei.king_zone[C];
+  ei.attacked[C] = ei.attacked_by[C][PAWN] | ei.attacked_by[C][KING];
 
-  // Knights:
-  center_phase_multiplier = (P == OPENING) ? 2 : ((P == MIDDLEGAME) ? 1 : 0);
+  ei.mobility_area[C] = ~(blocked_pawns | pos.pieces(C, KING) |
+                          pawn_attacks_bb(~C, pos.pieces(~C, PAWN)));
 
-  while (knights) {
-    Square knight_sq = lsb(pop_lsb(knights));
-    BitBoard knight_attack = attacks_bb(knight_sq, KNIGHT);
+  ei.king_zone_defenses[C] = 0;
+  ei.king_zone_attacks[C] = 0;
+}
 
-    score += (int)(0.07 * KNIGHT_VALUE * popcount(knight_attack));
-    score += center_phase_multiplier * OUTER_CENTER_BONUS *
-             popcount(OUTER_CENTER & knight_sq);
-    score += center_phase_multiplier * INNER_CENTER_BONUS *
-             popcount(INNER_CENTER & knight_attack);
-  }
+template <Color C, PieceType Pt>
+Score score_pieces(Position& pos, EvalInfo& ei) {
+  Score score = SCORE_ZERO;
 
-  // Bishops:
-  center_phase_multiplier = (P == OPENING) ? 2 : ((P == MIDDLEGAME) ? 1 : 0);
+  BitBoard pieces = pos.pieces(C, Pt);
+  BitBoard occ = pos.pieces();
 
-  while (bishops) {
-    Square bishop_sq = lsb(pop_lsb(bishops));
-    BitBoard bishop_attack = attacks_bb(bishop_sq, BISHOP, occ);
+  ei.attacked_by[C][Pt] = 0;
 
-    for (Direction d : {NORTH_EAST, NORTH_WEST, SOUTH_EAST, SOUTH_WEST}) {
-      BitBoard bishop_attack_ray = bishop_attack & get_ray(bishop_sq, d);
-      int attack_squares_nb = popcount(bishop_attack_ray);
+  while (pieces) {
+    Square s = lsb(pop_lsb(pieces));
+    BitBoard attacks = attacks_bb(s, Pt, occ);
 
-      score += (int)(0.05 * BISHOP_VALUE * attack_squares_nb);
-      score += (int)(0.01 * BISHOP_VALUE * std::max(0, attack_squares_nb - 3));
-    }
-    score += (OUTER_CENTER & bishop_sq)
-                 ? center_phase_multiplier * OUTER_CENTER_BONUS
-                 : 0;
-  }
+    ei.attacked_by[C][Pt] |= attacks;
+    ei.king_zone_defenses[C] += popcount(attacks & ei.king_zone[C]);
+    ei.king_zone_attacks[C] += popcount(attacks & ei.king_zone[~C]);
 
-  // Rooks;
-  while (rooks) {
-    Square rook_sq = lsb(pop_lsb(rooks));
-    BitBoard rook_attack = attacks_bb(rook_sq, ROOK);
+    int mobility = popcount(attacks & ei.mobility_area[C]);
+    score += MobilityBonus[Pt] * (mobility - MobilityAverage[Pt]);
 
-    score += (int)0.05 * ROOK_VALUE * popcount(rook_attack);
-    score += ROOKS_CONNECTED_BONUS * popcount(rook_attack & rooks);
-    score += pos.pieces(PAWN) & file_of(rook_sq) ? 0 : OPEN_FILE_BONUS;
-  }
+    if constexpr (Pt == KNIGHT || Pt == BISHOP) {
+      constexpr BitBoard OutpostRanks =
+          C == WHITE ? RANK_4_BB | RANK_5_BB | RANK_6_BB
+                     : RANK_5_BB | RANK_4_BB | RANK_3_BB;
+
+      BitBoard outposts = OutpostRanks & ei.attacked_by[C][PAWN] &
+                          ~ei.pawns->attacks_span(~C);
 
-  // Queens:
-  phase_multiplier = (P == OPENING) ? 0.01 : ((P == MIDDLEGAME) ? 0.7 : 1.5);
+      if (outposts & s)
+        score += OUTPOST_BONUS;
+    }
 
-  while (queens) {
-    Square queen_sq = lsb(pop_lsb(queens));
-    BitBoard queen_attack = attacks_bb(queen_sq, ROOK);
+    if constexpr (Pt == ROOK) {
+      score += ROOKS_CONNECTED_BONUS * popcount(attacks & pos.pieces(C, ROOK));
 
-    score +=
-        (int)(phase_multiplier * 0.01 * QUEEN_VALUE * popcount(queen_attack));
+      if (!(pos.pieces(PAWN) & file_bb(s)))
+        score += ROOK_OPEN_FILE_BONUS;
+    }
   }
 
-  // King:
-  phase_multiplier = (P == OPENING) ? 0 : ((P == MIDDLEGAME) ? 0.5 : 3);
-
-  score += phase_multiplier * popcount(attacks_bb(king_sq, KING));
-  score +=
-      phase_multiplier * OUTER_CENTER_BONUS * popcount(OUTER_CENTER & king_sq);
+  ei.attacked[C] |= ei.attacked_by[C][Pt];
 
   return score;
 }
 
-template <Color C, Phase P>
-Value score_king_safety(Position& pos) {
-  Square king_sq = lsb(pos.pieces(C, KING));
-  const BitBoard king_zone = attacks_bb(king_sq, KING);
+template <Color C>
+Score score_king_safety(Position& pos, const EvalInfo& ei) {
+  const BitBoard king_zone = ei.king_zone[C];
 
-  BitBoard pawn_shield_zone =
-      king_zone & rank_bb(Rank(rank_of(king_sq) + (C == WHITE ? 1 : -1)));
+  Score score = ei.pawns->king_shelter<C>(pos);
 
-  int phase_multiplier = (P == OPENING) ? 1 : ((P == MIDDLEGAME) ? 2 : 0);
+  // Pawn and king attacks are counted per square, like the other pieces
+  int defenses = ei.king_zone_defenses[C] +
+                 popcount(ei.attacked_by[C][PAWN] & king_zone) +
+                 popcount(ei.attacked_by[C][KING] & king_zone);
+  int attacks = ei.king_zone_attacks[~C] +
+                popcount(ei.attacked_by[~C][PAWN] & king_zone) +
+                popcount(ei.attacked_by[~C][KING] & king_zone);
 
-  int pawn_shield =
-      phase_multiplier *
-      (-50 + 20 * popcount(pawn_shield_zone & pos.pieces(C, PAWN)));
-  int open_file = (pos.pieces(PAWN) & file_bb(king_sq)) ? 0 : -OPEN_FILE_BONUS;
-  int def_atk_squares =
-      3 * pos.count_attacks(C, king_zone) - pos.count_attacks(~C, king_zone);
+  score += KING_ZONE_DEFENSE * defenses;
+  score -= KING_ZONE_ATTACK * attacks;
 
-  return pawn_shield + open_file + def_atk_squares;
+  return score;
 }
 
-template <Color C, Phase P>
-Value score_pawns(Position& pos) {
-  BitBoard pawns = pos.pieces(C, PAWN);
-  BitBoard opp_pawns = pos.pieces(~C, PAWN);
-  BitBoard pawns_temp = pawns;
-  Value score = 0;
-
-  constexpr Direction UP_RIGHT = C == WHITE ? NORTH_EAST : SOUTH_WEST;
-  constexpr Direction UP_LEFT = C == WHITE ? NORTH_WEST : SOUTH_EAST;
-
-  BitBoard pawns_attack = shift<UP_RIGHT>(pawns) | shift<UP_LEFT>(pawns);
-
-  score += 5 * popcount(pawns_attack & pawns);
-
-  while (pawns_temp) {
-    BitBoard pawn_bb = pop_lsb(pawns_temp);
-    Square pawn_sq = lsb(pawn_bb);
-    BitBoard nearby_files_bb = file_bb(pawn_sq);
-
-    nearby_files_bb |= shift<EAST>(nearby_files_bb);
-    nearby_files_bb |= shift<WEST>(nearby_files_bb);
-
-    // Isolated pawn penalty
-    score += (int)nearby_files_bb & ~pawn_bb ? 0 : -0.4 * PAWN_VALUE;
-
-    // Isolate files to the squares above the pawn
-    nearby_files_bb &=
-        ~(rank_bb(pawn_sq) | (C == WHITE ? BitBoard(((1ULL << pawn_sq) - 1))
-                                         : ~BitBoard((1ULL << pawn_sq) - 1)));
-
-    score += popcount(pawns & nearby_files_bb) + 1 >
-                     popcount(opp_pawns & nearby_files_bb)
-                 ? PASS_PAWN_BONUS
-                 : 0;
-  }
-
-  return score;
+// Threats of C on the pieces of the other side
+template <Color C>
+Score score_threats(Position& pos, const EvalInfo& ei) {
+  constexpr Color Them = ~C;
+
+  BitBoard pieces =
+      pos.pieces(Them) & ~pos.pieces(Them, PAWN) & ~pos.pieces(Them, KING);
+  BitBoard majors = pos.pieces(Them, ROOK) | pos.pieces(Them, QUEEN);
+  BitBoard minor_attacks =
+      ei.attacked_by[C][KNIGHT] | ei.attacked_by[C][BISHOP];
+  BitBoard hanging = (pos.pieces(Them) & ~pos.pieces(Them, KING)) &
+                     ei.attacked[C] & ~ei.attacked[Them];
+
+  return THREAT_BY_PAWN * popcount(pieces & ei.attacked_by[C][PAWN]) +
+         THREAT_BY_MINOR * popcount(majors & minor_attacks) +
+         HANGING_PIECE * popcount(hanging);
 }
 }  // namespace Juujfish
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include <cstdlib>
+
+#include "largepage.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace Juujfish {
+
+inline size_t round_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+const char* to_string(LargePageMode mode) {
+  switch (mode) {
+    case HUGETLB_PAGES:
+      return "hugetlb pages";
+    case TRANSPARENT_HUGE_PAGES:
+      return "transparent huge pages";
+    default:
+      return "normal pages";
+  }
+}
+
+void* large_page_alloc(size_t size, LargePageMode& mode) {
+  size = round_up(size, LARGE_PAGE_SIZE);
+
+#if defined(__linux__)
+  // 1. Explicit huge pages, only available if the system reserved some
+  void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+  if (mem != MAP_FAILED) {
+    mode = HUGETLB_PAGES;
+    return mem;
+  }
+
+  // 2. Transparent huge pages on 2 MiB aligned memory
+  mem = std::aligned_alloc(LARGE_PAGE_SIZE, size);
+
+  if (mem && madvise(mem, size, MADV_HUGEPAGE) == 0) {
+    mode = TRANSPARENT_HUGE_PAGES;
+    return mem;
+  }
+
+  mode = NORMAL_PAGES;
+  return mem;
+#else
+  mode = NORMAL_PAGES;
+  return std::aligned_alloc(LARGE_PAGE_SIZE, size);
+#endif
+}
+
+void large_page_free(void* mem, size_t size, LargePageMode mode) {
+  if (!mem)
+    return;
+
+#if defined(__linux__)
+  if (mode == HUGETLB_PAGES) {
+    munmap(mem, round_up(size, LARGE_PAGE_SIZE));
+    return;
+  }
+#else
+  (void)size;
+  (void)mode;
+#endif
+
+  std::free(mem);
+}
+
+}  // namespace Juujfish
@@ -0,0 +1,103 @@
+#include "material.h"
+
+namespace Juujfish {
+
+namespace {
+
+inline int count(const Position& pos, Color c, PieceType pt) {
+  return popcount(pos.pieces(c, pt));
+}
+
+inline bool is_lone_king(const Position& pos, Color c) {
+  return popcount(pos.pieces(c)) == 1;
+}
+
+template <Color C>
+Score imbalance(const Position& pos) {
+  int pawns_above_five = count(pos, C, PAWN) - 5;
+  Score score = SCORE_ZERO;
+
+  if (count(pos, C, BISHOP) >= 2)
+    score += BISHOP_PAIR_BONUS;
+
+  score += KNIGHT_PAWN_ADJUSTMENT * (count(pos, C, KNIGHT) * pawns_above_five);
+  score -= ROOK_PAWN_ADJUSTMENT * (count(pos, C, ROOK) * pawns_above_five);
+
+  return score;
+}
+
+// Returns the evaluation function of a known ending with C as the strong side
+template <Color C>
+EndgameValue find_endgame(const Position& pos) {
+  if (!is_lone_king(pos, ~C))
+    return nullptr;
+
+  int pieces = popcount(pos.pieces(C));
+
+  if (pieces == 2 && count(pos, C, PAWN) == 1)
+    return &Endgames::KPK;
+  if (pieces == 2 && count(pos, C, ROOK) == 1)
+    return &Endgames::KRK;
+  if (pieces == 3 && count(pos, C, BISHOP) == 1 && count(pos, C, KNIGHT) == 1)
+    return &Endgames::KBNK;
+
+  return nullptr;
+}
+
+// Without pawns a side needs more than a minor piece of extra material to
+// win
+template <Color C>
+int pawnless_scale_factor(const Position& pos) {
+  Value npm = pos.non_pawn_material(C);
+  Value opp_npm = pos.non_pawn_material(~C);
+
+  if (count(pos, C, PAWN) || npm - opp_npm > BISHOP_VALUE)
+    return SCALE_FACTOR_NORMAL;
+
+  return npm < ROOK_VALUE        ? SCALE_FACTOR_DRAW
+         : opp_npm <= BISHOP_VALUE ? 4
+                                   : 14;
+}
+
+}  // namespace
+
+void MaterialTable::clear() {
+  for (MaterialEntry& entry : entries) {
+    entry = MaterialEntry{};
+    entry.factor[WHITE] = entry.factor[BLACK] = SCALE_FACTOR_NORMAL;
+  }
+}
+
+MaterialEntry* MaterialTable::probe(const Position& pos) {
+  Key key = pos.get_material_key();
+  MaterialEntry* entry = &entries[key & (MATERIAL_TABLE_SIZE - 1)];
+
+  if (entry->key == key)
+    return entry;
+
+  *entry = MaterialEntry{};
+  entry->key = key;
+  entry->factor[WHITE] = entry->factor[BLACK] = SCALE_FACTOR_NORMAL;
+
+  if ((entry->endgame = find_endgame<WHITE>(pos))) {
+    entry->strong_side = WHITE;
+    return entry;
+  }
+
+  if ((entry->endgame = find_endgame<BLACK>(pos))) {
+    entry->strong_side = BLACK;
+    return entry;
+  }
+
+  entry->imbalance = imbalance<WHITE>(pos) - imbalance<BLACK>(pos);
+
+  entry->factor[WHITE] = pawnless_scale_factor<WHITE>(pos);
+  entry->factor[BLACK] = pawnless_scale_factor<BLACK>(pos);
+
+  if (count(pos, WHITE, BISHOP) == 1 && count(pos, BLACK, BISHOP) == 1)
+    entry->scaling = &Endgames::opposite_bishops;
+
+  return entry;
+}
+
+}  // namespace Juujfish
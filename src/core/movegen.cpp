@@ -20,6 +20,12 @@ GradedMove* generate_promotions(GradedMove* move_list, Square to) {
   return move_list;
 }
 
+// Pinned pawns may only move along the line they are pinned on
+template <Direction D>
+inline BitBoard pawn_targets(BitBoard pawns, BitBoard pin_mask) {
+  return shift<D>(pawns & ~pin_mask) | (shift<D>(pawns & pin_mask) & pin_mask);
+}
+
 template <Color C, GenType Gt>
 GradedMove* generate_pawn_moves(const Position& pos, GradedMove* move_list,
                                 BitBoard target) {
@@ -35,8 +41,14 @@ GradedMove* generate_pawn_moves(const Position& pos, GradedMove* move_list,
   const BitBoard enemies = Gt == EVASIONS ? pos.get_checkers() : pos.pieces(~C);
   const BitBoard empty_squares = ~pos.pieces();
 
+  // Pawns pinned on a diagonal cannot push, pawns pinned on a rank or file
+  // cannot capture
+  const BitBoard pin_hv = pos.get_pin_hv_mask(C);
+  const BitBoard pin_diag = pos.get_pin_diag_mask(C);
+
   if constexpr (Gt != CAPTURES) {
-    BitBoard push_1 = shift<UP>(pawns_not_on_7) & empty_squares;
+    BitBoard push_1 =
+        pawn_targets<UP>(pawns_not_on_7 & ~pin_diag, pin_hv) & empty_squares;
     BitBoard push_2 = shift<UP>(push_1 & (C == WHITE ? RANK_3_BB : RANK_6_BB)) &
                       empty_squares;
 
@@ -59,8 +71,10 @@ GradedMove* generate_pawn_moves(const Position& pos, GradedMove* move_list,
   }
 
   if constexpr (Gt == CAPTURES || Gt == EVASIONS || Gt == NON_EVASIONS) {
-    BitBoard right_attack = shift<UP_RIGHT>(pawns_not_on_7) & enemies;
-    BitBoard left_attack = shift<UP_LEFT>(pawns_not_on_7) & enemies;
+    BitBoard right_attack =
+        pawn_targets<UP_RIGHT>(pawns_not_on_7 & ~pin_hv, pin_diag) & enemies;
+    BitBoard left_attack =
+        pawn_targets<UP_LEFT>(pawns_not_on_7 & ~pin_hv, pin_diag) & enemies;
 
     while (right_attack) {
       Square to = lsb(pop_lsb(right_attack));
@@ -78,17 +92,26 @@ GradedMove* generate_pawn_moves(const Position& pos, GradedMove* move_list,
       Square to = pos.get_ep_square();
       BitBoard ep_pawns = pawn_attacks_bb(~C, to) & pawns_not_on_7;
 
+      // In check, en passant can only capture the checking pawn
+      if (Gt == EVASIONS && !(enemies & (to - UP)))
+        ep_pawns = 0;
+
+      // Two pawns leave the same rank, so the pin masks are not enough
       while (ep_pawns) {
-        Square from = lsb(pop_lsb(ep_pawns));
-        *move_list++ = Move::make<ENPASSANT>(to, from);
+        Move m = Move::make<ENPASSANT>(to, lsb(pop_lsb(ep_pawns)));
+        if (pos.legal(m))
+          *move_list++ = m;
       }
     }
   }
 
   if (pawns_on_7 != 0) {
-    BitBoard right_attack = shift<UP_RIGHT>(pawns_on_7) & enemies;
-    BitBoard left_attack = shift<UP_LEFT>(pawns_on_7) & enemies;
-    BitBoard up_push = shift<UP>(pawns_on_7) & empty_squares;
+    BitBoard right_attack =
+        pawn_targets<UP_RIGHT>(pawns_on_7 & ~pin_hv, pin_diag) & enemies;
+    BitBoard left_attack =
+        pawn_targets<UP_LEFT>(pawns_on_7 & ~pin_hv, pin_diag) & enemies;
+    BitBoard up_push =
+        pawn_targets<UP>(pawns_on_7 & ~pin_diag, pin_hv) & empty_squares;
 
     if constexpr (Gt == EVASIONS)
       up_push &= target;
@@ -116,11 +139,23 @@ GradedMove* generate_piece_moves(const Position& pos, GradedMove* move_list,
       Pt != PAWN && Pt != KING,
       "Error: Pawn and King moves are not supported by generate_moves.");
 
-  BitBoard bb = pos.pieces(C, Pt);
+  const BitBoard pin_hv = pos.get_pin_hv_mask(C);
+  const BitBoard pin_diag = pos.get_pin_diag_mask(C);
+
+  // Pieces pinned on a line they cannot move along have no moves
+  BitBoard bb = pos.pieces(C, Pt) & ~(Pt == KNIGHT   ? pin_hv | pin_diag
+                                      : Pt == BISHOP ? pin_hv
+                                      : Pt == ROOK   ? pin_diag
+                                                     : 0);
 
   while (bb) {
     Square from = lsb(pop_lsb(bb));
-    BitBoard moves_bb = attacks_bb(from, Pt, pos.pieces()) & target;
+    BitBoard moves_bb =
+        (pin_hv & from)     ? attacks_bb(from, ROOK, pos.pieces()) & pin_hv
+        : (pin_diag & from) ? attacks_bb(from, BISHOP, pos.pieces()) & pin_diag
+                            : attacks_bb(from, Pt, pos.pieces());
+
+    moves_bb &= target;
 
     while (moves_bb) {
       Square to = lsb(pop_lsb(moves_bb));
@@ -177,23 +212,34 @@ GradedMove* generate_moves(const Position& pos, GradedMove* move_list) {
     move_list = generate_piece_moves<Us, QUEEN>(pos, move_list, target);
   }
 
+  // The king is taken off the board, so that it cannot hide behind itself
+  // from a slider
   BitBoard king_moves_bb =
       attacks_bb(king_sq, KING) & (Gt == EVASIONS ? ~pos.pieces(Us) : target);
-  while (king_moves_bb)
-    *move_list++ = Move::make<NORMAL>(lsb(pop_lsb(king_moves_bb)), king_sq);
+  BitBoard occupied = pos.pieces() ^ king_sq;
+
+  while (king_moves_bb) {
+    Square to = lsb(pop_lsb(king_moves_bb));
+    if (!pos.sq_is_attacked(Us, to, occupied))
+      *move_list++ = Move::make<NORMAL>(to, king_sq);
+  }
 
   if ((Gt == QUIETS || Gt == NON_EVASIONS) && pos.can_castle(Us & ANY_CASTLING))
     for (CastlingRights cr : {Us & KING_SIDE, Us & QUEEN_SIDE})
-      if (!pos.castling_blocked(cr) && pos.can_castle(cr))
+      if (pos.can_castle(cr) && !pos.castling_blocked(cr) &&
+          !pos.castling_attacked(cr))
         *move_list++ = Move::make<CASTLING>(castling_king_to(cr), king_sq);
 
   return move_list;
 }
 
+/*
+  Every generation type only emits legal moves: pinned pieces are restricted
+  to their pin masks, other pieces to the check mask held in target, and the
+  king to squares not attacked once it has left its square.
+*/
 template <GenType Gt>
 GradedMove* generate(const Position& pos, GradedMove* move_list) {
-  static_assert(Gt != LEGAL,
-                "Error: Legal moves generation is not supported right now.");
   assert((Gt == EVASIONS) == bool(pos.get_checkers()));
 
   Color us = pos.get_side_to_move();
@@ -209,25 +255,8 @@ template GradedMove* generate<NON_EVASIONS>(const Position&, GradedMove*);
 
 template <>
 GradedMove* generate<LEGAL>(const Position& pos, GradedMove* move_list) {
-  Color us = pos.get_side_to_move();
-
-  Square king_sq = lsb(pos.pieces(us, KING));
-  BitBoard pinned = pos.get_blockers(us) & pos.pieces(us);
-
-  GradedMove* curr = move_list;
-
-  move_list = pos.is_in_check() ? generate<EVASIONS>(pos, move_list)
-                                : generate<NON_EVASIONS>(pos, move_list);
-
-  while (curr != move_list)
-    if (((curr->from_sq() & pinned) || (curr->from_sq() == king_sq) ||
-         (curr->type_of() == ENPASSANT)) &&
-        !pos.legal(*curr))
-      *curr = *(--move_list);
-    else
-      curr++;
-
-  return move_list;
+  return pos.is_in_check() ? generate<EVASIONS>(pos, move_list)
+                           : generate<NON_EVASIONS>(pos, move_list);
 }
 
 }  // namespace Juujfish
\ No newline at end of file
@@ -16,16 +16,18 @@ void partial_insertion_sort(GradedMove* begin, GradedMove* end, int threshold) {
   }
 }
 
+// Most valuable victim first, least valuable attacker breaks ties. Whether
+// the capture actually wins material is left to Position::see_ge.
 inline int mvv_lva(const PieceType victim, const PieceType attacker) {
   assert(victim >= PAWN && attacker >= PAWN);
   assert(victim <= KING && attacker <= KING);
-  return PieceValue[victim] - PieceValue[attacker];
+  return PIECE_TYPE_NB * PieceValue[victim] - attacker;
 }
 
 template <typename Pred>
 Move MoveOrderer::select(Pred filter) {
   for (; curr != end_moves; ++curr)
-    if (filter())
+    if (*curr != table_move && filter())
       return *curr++;
   return Move::null_move();
 }
@@ -98,15 +100,13 @@ void MoveOrderer::score() {
       m.value = value;
 
     } else if constexpr (Gt == EVASIONS) {
-      if (pos.is_capture(m)) {
-        if (type_of(pos.piece_at(to)) > KING)
-          std::cout << "Error: Invalid piece on square. " << type_of(pos.piece_at(to)) << std::endl;
-        assert(type_of(pos.piece_at(to)) >= PAWN);
-        assert(type_of(pos.piece_at(to)) <= KING);
-      }
-        
-      if (pos.is_capture(m))
-        m.value = PieceValue[type_of(pos.piece_at(to))] + (1 << 20);
+      // En passant and quiet queen promotions count as captures but leave
+      // the target square empty
+      Piece capture_piece =
+          mt == ENPASSANT ? piece_of(~us, PAWN) : pos.piece_at(to);
+
+      if (capture_piece != NO_PIECE)
+        m.value = PieceValue[type_of(capture_piece)] + (1 << 20);
       else
         m.value = killers->lookup(m, ply) +
                   (history->lookup(m, us, pt) / butterfly->lookup(m, us));
@@ -139,9 +139,10 @@ top:
       [[fallthrough]];
 
     case CAPTURE:
+      // Captures losing material in the exchange are deferred to BAD_CAPTURE
       if (select([&]() {
-            return curr->value >= 0 ? true
-                                    : (*end_bad_captures++ = *curr, false);
+            return pos.see_ge(*curr) ? true
+                                     : (*end_bad_captures++ = *curr, false);
           }))
         return *(curr - 1);
 
@@ -208,6 +209,27 @@ top:
 
     case EVASION:
       return select([]() { return true; });
+
+    // QUIESCENCE:
+    case QSEARCH_TT:
+      ++stage;
+      if (!table_move.is_nullmove() && pos.is_capture(table_move))
+        return table_move;
+      else
+        goto top;
+
+    case QCAPTURES_GEN:
+      curr = moves;
+      end_moves = generate<CAPTURES>(pos, curr);
+
+      score<CAPTURES>();
+      partial_insertion_sort(curr, end_moves, std::numeric_limits<int>::min());
+
+      ++stage;
+      [[fallthrough]];
+
+    case QCAPTURE:
+      return select([]() { return true; });
   }
 
   std::cerr << "Error: Got to end of MoveOrderer." << std::endl;
@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+#include "nnue.h"
+
+#include "largepage.h"
+#include "position.h"
+
+namespace Juujfish {
+
+namespace {
+
+constexpr int TRANSFORMED_DIMENSIONS = 2 * NNUE_HALF_DIMENSIONS;
+
+// Squares are rotated for the black perspective, so that both sides see their
+// own pieces from the first rank
+constexpr Square orient(Color perspective, Square s) {
+  return Square(perspective == WHITE ? int(s) : int(s) ^ 63);
+}
+
+constexpr int feature_index(Color perspective, Square king_sq, Piece pc,
+                            Square s) {
+  int piece_index = int(type_of(pc)) * 2 + (color_of(pc) != perspective);
+
+  return orient(perspective, s) + 1 + piece_index * SQUARE_NB +
+         NNUE_PS_END * king_sq;
+}
+
+/*
+  Vector kernels. The AVX2 and SSE4.1 versions are picked at compile time
+  from -mavx2 and -msse4.1, anything else uses the scalar loops. All of them
+  give exactly the same results.
+*/
+inline void add_weights(std::int16_t* acc, const std::int16_t* weights) {
+#if defined(__AVX2__)
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; j += 16) {
+    __m256i* a = reinterpret_cast<__m256i*>(acc + j);
+    __m256i w =
+        _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + j));
+    _mm256_store_si256(a, _mm256_add_epi16(_mm256_load_si256(a), w));
+  }
+#elif defined(__SSE4_1__)
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; j += 8) {
+    __m128i* a = reinterpret_cast<__m128i*>(acc + j);
+    __m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + j));
+    _mm_store_si128(a, _mm_add_epi16(_mm_load_si128(a), w));
+  }
+#else
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; ++j)
+    acc[j] += weights[j];
+#endif
+}
+
+inline void sub_weights(std::int16_t* acc, const std::int16_t* weights) {
+#if defined(__AVX2__)
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; j += 16) {
+    __m256i* a = reinterpret_cast<__m256i*>(acc + j);
+    __m256i w =
+        _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + j));
+    _mm256_store_si256(a, _mm256_sub_epi16(_mm256_load_si256(a), w));
+  }
+#elif defined(__SSE4_1__)
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; j += 8) {
+    __m128i* a = reinterpret_cast<__m128i*>(acc + j);
+    __m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + j));
+    _mm_store_si128(a, _mm_sub_epi16(_mm_load_si128(a), w));
+  }
+#else
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; ++j)
+    acc[j] -= weights[j];
+#endif
+}
+
+// Clamps one half of the accumulator to 0..127
+inline void clip_accumulation(const std::int16_t* acc, std::uint8_t* output) {
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; j += 32) {
+    __m256i a0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + j));
+    __m256i a1 =
+        _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + j + 16));
+    // The pack works within 128 bit lanes, the permute restores the order
+    __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a0, a1), zero);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(output + j),
+                       _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+#elif defined(__SSE4_1__)
+  const __m128i zero = _mm_setzero_si128();
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; j += 16) {
+    __m128i a0 = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + j));
+    __m128i a1 = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + j + 8));
+    _mm_store_si128(reinterpret_cast<__m128i*>(output + j),
+                    _mm_max_epi8(_mm_packs_epi16(a0, a1), zero));
+  }
+#else
+  for (int j = 0; j < NNUE_HALF_DIMENSIONS; ++j)
+    output[j] = std::uint8_t(std::clamp(int(acc[j]), 0, 127));
+#endif
+}
+
+template <int Dims>
+inline void clipped_relu(const std::int32_t* input, std::uint8_t* output) {
+  for (int i = 0; i < Dims; ++i)
+    output[i] = std::uint8_t(
+        std::clamp(input[i] >> NNUE_WEIGHT_SCALE_BITS, 0, 127));
+}
+
+template <typename T>
+bool read_array(std::istream& is, T* data, size_t count) {
+  // The files are little endian, like every target of this engine
+  is.read(reinterpret_cast<char*>(data), sizeof(T) * count);
+  return bool(is);
+}
+
+// Fully connected layer with int8 weights, stored row by row
+template <int InDims, int OutDims>
+struct AffineLayer {
+  static_assert(InDims % 32 == 0, "Inputs must fill whole vectors");
+
+  alignas(64) std::int32_t biases[OutDims];
+  alignas(64) std::int8_t weights[OutDims * InDims];
+
+  bool read(std::istream& is) {
+    return read_array(is, biases, OutDims) &&
+           read_array(is, weights, OutDims * InDims);
+  }
+
+  void propagate(const std::uint8_t* input, std::int32_t* output) const {
+#if defined(__AVX2__)
+    // The pairwise int16 sums of maddubs cannot saturate, inputs are <= 127
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i* in = reinterpret_cast<const __m256i*>(input);
+
+    for (int i = 0; i < OutDims; ++i) {
+      const __m256i* row =
+          reinterpret_cast<const __m256i*>(weights + i * InDims);
+      __m256i sum = _mm256_setzero_si256();
+
+      for (int j = 0; j < InDims / 32; ++j) {
+        __m256i product = _mm256_maddubs_epi16(_mm256_load_si256(in + j),
+                                               _mm256_load_si256(row + j));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(product, ones));
+      }
+
+      __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                     _mm256_extracti128_si256(sum, 1));
+      sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+      sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+      output[i] = biases[i] + _mm_cvtsi128_si32(sum128);
+    }
+#elif defined(__SSE4_1__)
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i* in = reinterpret_cast<const __m128i*>(input);
+
+    for (int i = 0; i < OutDims; ++i) {
+      const __m128i* row =
+          reinterpret_cast<const __m128i*>(weights + i * InDims);
+      __m128i sum = _mm_setzero_si128();
+
+      for (int j = 0; j < InDims / 16; ++j) {
+        __m128i product =
+            _mm_maddubs_epi16(_mm_load_si128(in + j), _mm_load_si128(row + j));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(product, ones));
+      }
+
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+      output[i] = biases[i] + _mm_cvtsi128_si32(sum);
+    }
+#else
+    for (int i = 0; i < OutDims; ++i) {
+      const std::int8_t* row = weights + i * InDims;
+      std::int32_t sum = biases[i];
+
+      for (int j = 0; j < InDims; ++j)
+        sum += row[j] * input[j];
+
+      output[i] = sum;
+    }
+#endif
+  }
+};
+
+// Input layer, its output is the accumulator kept in every StateInfo
+struct FeatureTransformer {
+  FeatureTransformer() = default;
+  FeatureTransformer(const FeatureTransformer&) = delete;
+  FeatureTransformer& operator=(const FeatureTransformer&) = delete;
+
+  ~FeatureTransformer() {
+    large_page_free(weights, WEIGHTS_SIZE, page_mode);
+  }
+
+  static constexpr size_t WEIGHTS_COUNT =
+      size_t(NNUE_INPUT_DIMENSIONS) * NNUE_HALF_DIMENSIONS;
+  static constexpr size_t WEIGHTS_SIZE = WEIGHTS_COUNT * sizeof(std::int16_t);
+
+  bool read(std::istream& is) {
+    weights =
+        static_cast<std::int16_t*>(large_page_alloc(WEIGHTS_SIZE, page_mode));
+
+    return weights && read_array(is, biases, NNUE_HALF_DIMENSIONS) &&
+           read_array(is, weights, WEIGHTS_COUNT);
+  }
+
+  const std::int16_t* feature_weights(int index) const {
+    return weights + size_t(index) * NNUE_HALF_DIMENSIONS;
+  }
+
+  alignas(64) std::int16_t biases[NNUE_HALF_DIMENSIONS];
+  std::int16_t* weights = nullptr;  // [NNUE_INPUT_DIMENSIONS][half dimensions]
+  LargePageMode page_mode = NORMAL_PAGES;
+};
+
+struct Network {
+  FeatureTransformer transformer;
+  AffineLayer<TRANSFORMED_DIMENSIONS, NNUE_HIDDEN_DIMENSIONS> hidden1;
+  AffineLayer<NNUE_HIDDEN_DIMENSIONS, NNUE_HIDDEN_DIMENSIONS> hidden2;
+  AffineLayer<NNUE_HIDDEN_DIMENSIONS, 1> output;
+};
+
+std::unique_ptr<Network> network;
+std::string network_file;
+
+// Recomputes the accumulator of one perspective from the board
+void refresh_accumulator(const Position& pos, Accumulator& acc,
+                         Color perspective) {
+  const FeatureTransformer& ft = network->transformer;
+  std::int16_t* accumulation = acc.accumulation[perspective];
+
+  Square king_sq = orient(perspective, lsb(pos.pieces(perspective, KING)));
+  BitBoard pieces = pos.pieces() & ~pos.pieces(KING);
+
+  std::memcpy(accumulation, ft.biases, sizeof(ft.biases));
+
+  while (pieces) {
+    Square s = lsb(pop_lsb(pieces));
+    add_weights(accumulation,
+                ft.feature_weights(
+                    feature_index(perspective, king_sq, pos.piece_at(s), s)));
+  }
+
+  acc.computed[perspective] = true;
+}
+
+/*
+  Brings the accumulator of the current state up to date. Going back from the
+  current state, the closest one that is already computed is searched for and
+  the changes of the moves made since then are applied forward. A move of the
+  perspective's own king changes every feature, as does a missing computed
+  state within NNUE_MAX_UPDATE_PLIES, and then the accumulator is refreshed.
+*/
+void update_accumulator(const Position& pos, Color perspective) {
+  StateInfo* states[NNUE_MAX_UPDATE_PLIES];
+  StateInfo* curr = pos.get_state();
+  int count = 0;
+
+  Piece our_king = piece_of(perspective, KING);
+
+  for (; !curr->accumulator.computed[perspective]; curr = curr->prev) {
+    if (count == NNUE_MAX_UPDATE_PLIES || !curr->prev ||
+        (curr->dirty_piece.dirty_num &&
+         curr->dirty_piece.piece[0] == our_king)) {
+      refresh_accumulator(pos, pos.get_state()->accumulator, perspective);
+      return;
+    }
+
+    states[count++] = curr;
+  }
+
+  const FeatureTransformer& ft = network->transformer;
+  Square king_sq = orient(perspective, lsb(pos.pieces(perspective, KING)));
+
+  while (count--) {
+    StateInfo* state = states[count];
+    const DirtyPiece& dp = state->dirty_piece;
+    std::int16_t* accumulation = state->accumulator.accumulation[perspective];
+
+    std::memcpy(accumulation,
+                state->prev->accumulator.accumulation[perspective],
+                sizeof(state->accumulator.accumulation[perspective]));
+
+    for (int i = 0; i < dp.dirty_num; ++i) {
+      if (type_of(dp.piece[i]) == KING)
+        continue;
+
+      if (dp.from[i] != SQ_NONE)
+        sub_weights(accumulation,
+                    ft.feature_weights(feature_index(perspective, king_sq,
+                                                     dp.piece[i], dp.from[i])));
+
+      if (dp.to[i] != SQ_NONE)
+        add_weights(accumulation,
+                    ft.feature_weights(feature_index(perspective, king_sq,
+                                                     dp.piece[i], dp.to[i])));
+    }
+
+    state->accumulator.computed[perspective] = true;
+  }
+}
+
+}  // namespace
+
+/*
+  Reads a network in the format of the first Stockfish NNUE releases: a
+  header with the version, a hash and a description, then the feature
+  transformer and the three affine layers, each preceded by a hash. The hashes
+  only describe the architecture, which is already checked by requiring the
+  file to end exactly after the last layer.
+*/
+bool NNUE::load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+
+  if (!file) {
+    std::cerr << "Error: Cannot open the network file " << path << "."
+              << std::endl;
+    return false;
+  }
+
+  std::uint32_t version, hash, description_size;
+
+  if (!read_array(file, &version, 1) || !read_array(file, &hash, 1) ||
+      !read_array(file, &description_size, 1) || version != NNUE_VERSION) {
+    std::cerr << "Error: " << path << " is not a supported network file."
+              << std::endl;
+    return false;
+  }
+
+  file.ignore(description_size);
+
+  auto net = std::make_unique<Network>();
+
+  bool ok = read_array(file, &hash, 1) && net->transformer.read(file) &&
+            read_array(file, &hash, 1) && net->hidden1.read(file) &&
+            net->hidden2.read(file) && net->output.read(file) &&
+            file.peek() == std::ifstream::traits_type::eof();
+
+  if (!ok) {
+    std::cerr << "Error: The network file " << path
+              << " does not match the HalfKP 256x2-32-32-1 architecture."
+              << std::endl;
+    return false;
+  }
+
+  network = std::move(net);
+  network_file = path;
+
+  return true;
+}
+
+void NNUE::unload() {
+  network.reset();
+  network_file.clear();
+}
+
+bool NNUE::is_loaded() {
+  return network != nullptr;
+}
+
+const std::string& NNUE::loaded_file() {
+  return network_file;
+}
+
+Value NNUE::evaluate(Position& pos) {
+  assert(is_loaded());
+
+  Color us = pos.get_side_to_move();
+
+  update_accumulator(pos, WHITE);
+  update_accumulator(pos, BLACK);
+
+  const Accumulator& acc = pos.get_state()->accumulator;
+
+  alignas(64) std::uint8_t transformed[TRANSFORMED_DIMENSIONS];
+  alignas(64) std::int32_t hidden_sums[NNUE_HIDDEN_DIMENSIONS];
+  alignas(64) std::uint8_t hidden1_out[NNUE_HIDDEN_DIMENSIONS];
+  alignas(64) std::uint8_t hidden2_out[NNUE_HIDDEN_DIMENSIONS];
+  std::int32_t output;
+
+  clip_accumulation(acc.accumulation[us], transformed);
+  clip_accumulation(acc.accumulation[~us], transformed + NNUE_HALF_DIMENSIONS);
+
+  network->hidden1.propagate(transformed, hidden_sums);
+  clipped_relu<NNUE_HIDDEN_DIMENSIONS>(hidden_sums, hidden1_out);
+
+  network->hidden2.propagate(hidden1_out, hidden_sums);
+  clipped_relu<NNUE_HIDDEN_DIMENSIONS>(hidden_sums, hidden2_out);
+
+  network->output.propagate(hidden2_out, &output);
+
+  Value v = output / NNUE_FV_SCALE * PAWN_VALUE / NNUE_PAWN_VALUE;
+
+  // Keep clear of the mate scores
+  return std::clamp(v, -VALUE_MATE + MAX_PLY + 1, VALUE_MATE - MAX_PLY - 1);
+}
+
+}  // namespace Juujfish
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "pawns.h"
+
+namespace Juujfish {
+
+namespace {
+
+// Smears every bit towards the eighth rank for white, the first for black
+template <Color C>
+constexpr BitBoard fill_forward(BitBoard b) {
+  if constexpr (C == WHITE) {
+    b |= b << 8;
+    b |= b << 16;
+    b |= b << 32;
+  } else {
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+  }
+  return b;
+}
+
+template <Color C>
+void evaluate_pawns(const Position& pos, PawnEntry* entry) {
+  constexpr Color Them = ~C;
+  constexpr Direction DOWN = C == WHITE ? SOUTH : NORTH;
+
+  BitBoard pawns = pos.pieces(C, PAWN);
+  BitBoard opp_pawns = pos.pieces(Them, PAWN);
+  BitBoard pawns_temp = pawns;
+  Score score = SCORE_ZERO;
+
+  BitBoard pawns_attack = pawn_attacks_bb(C, pawns);
+
+  // Squares in front of the enemy pawns and the squares they may attack
+  BitBoard opp_front_span = fill_forward<Them>(shift<DOWN>(opp_pawns));
+  BitBoard opp_attacks_span =
+      fill_forward<Them>(pawn_attacks_bb(Them, opp_pawns));
+
+  entry->pawn_attacks_span[C] = fill_forward<C>(pawns_attack);
+  entry->passed_pawns[C] = pawns & ~(opp_front_span | opp_attacks_span);
+
+  score += PROTECTED_PAWN_BONUS * popcount(pawns_attack & pawns);
+
+  while (pawns_temp) {
+    Square pawn_sq = lsb(pop_lsb(pawns_temp));
+    BitBoard adjacent_files_bb =
+        shift<EAST>(file_bb(pawn_sq)) | shift<WEST>(file_bb(pawn_sq));
+
+    if (!(pawns & adjacent_files_bb))
+      score -= ISOLATED_PAWN_PENALTY;
+
+    if (entry->passed_pawns[C] & pawn_sq) {
+      Rank relative_rank = C == WHITE ? rank_of(pawn_sq)
+                                      : Rank(RANK_8 - rank_of(pawn_sq));
+      score += PassedPawnBonus[relative_rank];
+    }
+  }
+
+  entry->scores[C] = score;
+}
+
+}  // namespace
+
+template <Color C>
+Score PawnEntry::evaluate_shelter(const Position& pos, Square king_sq) const {
+  constexpr Direction UP = C == WHITE ? NORTH : SOUTH;
+
+  BitBoard pawn_shield_zone =
+      attacks_bb(king_sq, KING) & shift<UP>(rank_bb(king_sq));
+
+  Score score =
+      PAWN_SHIELD_BONUS * popcount(pawn_shield_zone & pos.pieces(C, PAWN)) -
+      NO_PAWN_SHIELD_PENALTY;
+
+  if (!(pos.pieces(PAWN) & file_bb(king_sq)))
+    score -= KING_OPEN_FILE_PENALTY;
+
+  return score;
+}
+
+template Score PawnEntry::evaluate_shelter<WHITE>(const Position& pos,
+                                                  Square king_sq) const;
+template Score PawnEntry::evaluate_shelter<BLACK>(const Position& pos,
+                                                  Square king_sq) const;
+
+PawnTable::PawnTable() {
+  entries = static_cast<PawnEntry*>(large_page_alloc(
+      PAWN_TABLE_SIZE * sizeof(PawnEntry), large_page_mode));
+
+  if (!entries) {
+    std::cerr << "Error: Failed to allocate the pawn table." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  clear();
+}
+
+PawnTable::~PawnTable() {
+  large_page_free(entries, PAWN_TABLE_SIZE * sizeof(PawnEntry),
+                  large_page_mode);
+}
+
+void PawnTable::clear() {
+  // The key of a position without pawns is zero, and so are its scores and
+  // bitboards, only the king squares must not match
+  for (size_t i = 0; i < PAWN_TABLE_SIZE; ++i) {
+    entries[i] = PawnEntry{};
+    entries[i].king_squares[WHITE] = entries[i].king_squares[BLACK] = SQ_NONE;
+  }
+}
+
+PawnEntry* PawnTable::probe(const Position& pos) {
+  Key key = pos.get_pawn_key();
+  PawnEntry* entry = &entries[key & (PAWN_TABLE_SIZE - 1)];
+
+  if (entry->key == key)
+    return entry;
+
+  entry->key = key;
+  entry->king_squares[WHITE] = entry->king_squares[BLACK] = SQ_NONE;
+
+  evaluate_pawns<WHITE>(pos, entry);
+  evaluate_pawns<BLACK>(pos, entry);
+
+  return entry;
+}
+
+}  // namespace Juujfish
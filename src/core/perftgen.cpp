@@ -0,0 +1,158 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "perftgen.h"
+
+#include "misc.h"
+#include "movegen.h"
+#include "thread.h"
+
+namespace Juujfish {
+
+void PerftTable::resize(size_t mb) {
+  free();
+
+  if (mb == 0)
+    return;
+
+  bucket_count = mb * 1024 * 1024 / sizeof(PerftBucket);
+
+  table = static_cast<PerftBucket*>(
+      large_page_alloc(bucket_count * sizeof(PerftBucket), large_page_mode));
+
+  if (!table) {
+    std::cerr << "Error: Failed to allocate " << mb
+              << " MB for the perft table." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::memset(static_cast<void*>(table), 0,
+              bucket_count * sizeof(PerftBucket));
+}
+
+void PerftTable::free() {
+  large_page_free(table, bucket_count * sizeof(PerftBucket), large_page_mode);
+
+  table = nullptr;
+  bucket_count = 0;
+}
+
+bool PerftTable::probe(Key zobrist_key, Depth depth,
+                       std::uint64_t& nodes) const {
+  const PerftBucket& bucket = table[bucket_index(zobrist_key)];
+
+  for (const PerftEntry& entry : bucket.entries) {
+    std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+    std::uint64_t key = entry.key.load(std::memory_order_relaxed) ^ data;
+
+    if (key == zobrist_key && Depth(data & 0xFF) == depth) {
+      nodes = data >> 8;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void PerftTable::store(Key zobrist_key, Depth depth, std::uint64_t nodes) {
+  PerftBucket& bucket = table[bucket_index(zobrist_key)];
+
+  std::uint64_t deepest =
+      bucket.entries[0].data.load(std::memory_order_relaxed);
+  PerftEntry& entry = Depth(deepest & 0xFF) <= depth ? bucket.entries[0]
+                                                      : bucket.entries[1];
+
+  std::uint64_t data = nodes << 8 | std::uint64_t(depth);
+
+  entry.data.store(data, std::memory_order_relaxed);
+  entry.key.store(zobrist_key ^ data, std::memory_order_relaxed);
+}
+
+namespace {
+
+std::uint64_t count(Position& pos, Depth depth, PerftTable* table) {
+  // The generator only emits legal moves, so the last ply is never made
+  if (depth == 1)
+    return MoveList<LEGAL>(pos).size();
+
+  std::uint64_t nodes = 0;
+
+  if (table && table->probe(pos.get_key(), depth, nodes))
+    return nodes;
+
+  StateInfo st;
+
+  for (const auto& m : MoveList<LEGAL>(pos)) {
+    pos.make_move(m, &st, pos.gives_check(m));
+    nodes += count(pos, depth - 1, table);
+    pos.unmake_move();
+  }
+
+  if (table && depth >= PERFT_HASH_MIN_DEPTH)
+    table->store(pos.get_key(), depth, nodes);
+
+  return nodes;
+}
+
+}  // namespace
+
+std::uint64_t Perft::perft(Position& pos, Depth depth, ThreadPool& threads,
+                           size_t hash_mb, bool divide) {
+  if (depth <= 0)
+    return 1;
+
+  // Kept between calls, entries of earlier positions never match a key of
+  // this one, so the table is only cleared when its size changes
+  static PerftTable table;
+  static size_t table_mb = 0;
+
+  if (hash_mb != table_mb) {
+    table.resize(hash_mb);
+    table_mb = hash_mb;
+  }
+
+  MoveList<LEGAL> root_moves(pos);
+  std::vector<Move> moves(root_moves.begin(), root_moves.end());
+  std::vector<std::uint64_t> counts(moves.size());
+
+  const std::string fen = pos.fen();
+  std::atomic<size_t> next_move{0};
+
+  // Every thread works on its own copy of the root position
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads.run_on_thread(i, [&]() {
+      StateInfo root_st, st;
+      Position root_pos;
+      root_pos.set(fen, &root_st);
+
+      for (size_t idx; (idx = next_move++) < moves.size();) {
+        if (depth == 1) {
+          counts[idx] = 1;
+          continue;
+        }
+
+        root_pos.make_move(moves[idx], &st, root_pos.gives_check(moves[idx]));
+        counts[idx] = count(root_pos, depth - 1, hash_mb ? &table : nullptr);
+        root_pos.unmake_move();
+      }
+    });
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads.wait_on_thread(i);
+
+  std::uint64_t nodes = 0;
+
+  for (size_t i = 0; i < moves.size(); ++i) {
+    nodes += counts[i];
+
+    if (divide)
+      std::cout << moveToString(moves[i]) << ": " << counts[i] << "\n";
+  }
+
+  return nodes;
+}
+
+}  // namespace Juujfish
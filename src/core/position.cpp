@@ -5,27 +5,48 @@
 
 namespace Juujfish {
 namespace Zobrist {
-Key psq[PIECE_NB][SQUARE_NB];
-Key black_to_move;
-Key castling_rights[4];
-Key ep_file[FILE_NB];
+
+// Fixed seed, so that keys and node counts are the same in every run
+constexpr std::uint64_t SEED = 1070372;
+
+struct Keys {
+  Key psq[PIECE_NB][SQUARE_NB];
+  Key black_to_move;
+  Key castling_rights[4];
+  Key ep_file[FILE_NB];
+};
+
+constexpr Keys generate_keys() {
+  PRNG rng(SEED);
+  Keys keys{};
+
+  for (int i = 0; i < PIECE_NB; ++i)
+    for (int j = 0; j < SQUARE_NB; ++j)
+      keys.psq[i][j] = rng.rand64();
+
+  keys.black_to_move = rng.rand64();
+
+  for (int i = 0; i < 4; ++i)
+    keys.castling_rights[i] = rng.rand64();
+
+  for (int i = 0; i < FILE_NB; ++i)
+    keys.ep_file[i] = rng.rand64();
+
+  return keys;
+}
+
+constexpr Keys keys = generate_keys();
+
+constexpr auto& psq = keys.psq;
+constexpr auto& black_to_move = keys.black_to_move;
+constexpr auto& castling_rights = keys.castling_rights;
+constexpr auto& ep_file = keys.ep_file;
+
 }  // namespace Zobrist
 
 BitBoard CastlingPaths[4];
 
 void Position::init() {
-  for (int i = 0; i < PIECE_NB; ++i) {
-    for (int j = 0; j < SQUARE_NB; ++j) {
-      Zobrist::psq[i][j] = random_key();
-    }
-  }
-  Zobrist::black_to_move = random_key();
-  for (int i = 0; i < 4; ++i) {
-    Zobrist::castling_rights[i] = random_key();
-  }
-  for (int i = 0; i < FILE_NB; ++i) {
-    Zobrist::ep_file[i] = random_key();
-  }
   CastlingPaths[0] = square_to_bb(SQ_F1) | square_to_bb(SQ_G1);
   CastlingPaths[1] =
       square_to_bb(SQ_B1) | square_to_bb(SQ_C1) | square_to_bb(SQ_D1);
@@ -105,6 +126,7 @@ void Position::set(const std::string& fen, StateInfo* new_st) {
   // 0. Reset position and read FEN
   std::memset(this, 0, sizeof(Position));
   std::memset(new_st, 0, sizeof(StateInfo));
+  std::fill(std::begin(board), std::end(board), NO_PIECE);
   st = new_st;
 
   // 0.5 Read fen string
@@ -138,6 +160,8 @@ void Position::set(const std::string& fen, StateInfo* new_st) {
       bool was_piece_set = set_piece(color_of(p), pt, Square(i));
       if (was_piece_set) {
         st->zobrist_key ^= Zobrist::psq[p][i];
+        st->material_key ^=
+            Zobrist::psq[p][popcount(pieces(color_of(p), pt)) - 1];
 
         switch (pt) {
           case PAWN:
@@ -205,20 +229,6 @@ void Position::set(const std::string& fen, StateInfo* new_st) {
   update_pinners_blockers();
 }
 
-void Position::copy(const Position& pos) {
-  boardBB = pos.boardBB;
-  for (Color c : {WHITE, BLACK}) {
-    colorBB[c] = pos.colorBB[c];
-    for (PieceType pt : {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING}) {
-      pieceBB[c][pt] = pos.pieceBB[c][pt];
-    }
-  }
-  StateInfo new_st;
-  copy_state(&new_st, pos.st);
-
-  st = &new_st;
-}
-
 bool Position::legal(Move m) const {
   Color us = get_side_to_move();
   Color them = ~us;
@@ -268,11 +278,93 @@ bool Position::legal(Move m) const {
   return !(get_blockers(us) & from) || ((get_ray(king_sq, from) & to) != 0);
 }
 
+/*
+  Checks that a move from an untrusted source (the transposition table) could
+  have been generated in this position, without generating the move list.
+  Mirrors the generator, so that legal() can be used on the move afterwards.
+*/
 bool Position::pseudo_legal(Move m) const {
   if (m.is_nullmove())
     return false;
-  return is_in_check() ? MoveList<EVASIONS>(*this).contains(m) :
-                        MoveList<NON_EVASIONS>(*this).contains(m);
+
+  Color us = get_side_to_move();
+  Color them = ~us;
+
+  Square from = m.from_sq();
+  Square to = m.to_sq();
+  MoveType mt = m.type_of();
+
+  Piece p = piece_at(from);
+
+  if (p == NO_PIECE || color_of(p) != us || (pieces(us) & to))
+    return false;
+
+  // Only promotions use the promotion type bits
+  if (mt != PROMOTION && m.promotion_type() != KNIGHT)
+    return false;
+
+  PieceType pt = type_of(p);
+
+  if (mt == CASTLING) {
+    CastlingRights cr = to > from ? us & KING_SIDE : us & QUEEN_SIDE;
+
+    return pt == KING && !is_in_check() && can_castle(cr) &&
+           !castling_blocked(cr) && to == castling_king_to(cr);
+  }
+
+  // In check, en passant can only capture the checking pawn
+  if (mt == ENPASSANT)
+    return pt == PAWN && can_en_passant() && to == get_ep_square() &&
+           (pawn_attacks_bb(us, from) & to) &&
+           (!is_in_check() ||
+            (get_checkers() & (to + (us == WHITE ? SOUTH : NORTH))));
+
+  if (pt == PAWN) {
+    const Direction up = us == WHITE ? NORTH : SOUTH;
+    const BitBoard last_rank = us == WHITE ? RANK_8_BB : RANK_1_BB;
+    const BitBoard second_rank = us == WHITE ? RANK_2_BB : RANK_7_BB;
+
+    // Promotions must reach the last rank, and only promotions may
+    if ((mt == PROMOTION) != bool(last_rank & to))
+      return false;
+
+    bool capture = pawn_attacks_bb(us, from) & pieces(them) & to;
+    bool single_push = to == from + up && !is_occupied(to);
+    bool double_push = (second_rank & from) && to == from + up + up &&
+                       !is_occupied(from + up) && !is_occupied(to);
+
+    if (!capture && !single_push && !double_push)
+      return false;
+
+  } else if (mt == PROMOTION) {
+    return false;
+
+  } else if (!(attacks_bb(from, pt, pieces()) & to)) {
+    return false;
+  }
+
+  // Evasions: the king may step anywhere legal() allows, other pieces must
+  // capture the single checker or block it
+  if (is_in_check() && pt != KING) {
+    BitBoard checkers = get_checkers();
+
+    if (popcount(checkers) > 1)
+      return false;
+
+    Square king_sq = lsb(pieces(us, KING));
+    Square checker_sq = lsb(checkers);
+    PieceType checker_pt = type_of(piece_at(checker_sq));
+
+    BitBoard target = checker_pt == PAWN || checker_pt == KNIGHT
+                          ? checkers
+                          : attacks_bb(king_sq, QUEEN, checkers) &
+                                get_ray(king_sq, checker_sq);
+
+    if (!(target & to))
+      return false;
+  }
+
+  return true;
 }
 
 bool Position::gives_check(Move m) const {
@@ -437,6 +529,107 @@ BitBoard Position::attacked_by(Color c, Square s) const {
   return attack_pieces;
 }
 
+BitBoard Position::attacked_by(Square s, BitBoard occupied) const {
+  return (pawn_attacks_bb(BLACK, s) & pieces(WHITE, PAWN)) |
+         (pawn_attacks_bb(WHITE, s) & pieces(BLACK, PAWN)) |
+         (attacks_bb(s, KNIGHT) & pieces(KNIGHT)) |
+         (attacks_bb(s, BISHOP, occupied) &
+          (pieces(BISHOP) | pieces(QUEEN))) |
+         (attacks_bb(s, ROOK, occupied) & (pieces(ROOK) | pieces(QUEEN))) |
+         (attacks_bb(s, KING) & pieces(KING));
+}
+
+/*
+  Static Exchange Evaluation: plays out the capture sequence on the target
+  square with the least valuable attacker first (swap list), revealing x-ray
+  attackers through the magic tables as pieces leave the board. Returns true
+  if the side to move comes out of the exchange with at least threshold.
+*/
+bool Position::see_ge(Move m, Value threshold) const {
+  // Castling, en passant and promotions are treated as even exchanges
+  if (m.type_of() != NORMAL)
+    return VALUE_ZERO >= threshold;
+
+  Square from = m.from_sq(), to = m.to_sq();
+
+  Piece captured = piece_at(to);
+
+  int swap =
+      (captured == NO_PIECE ? 0 : PieceValue[type_of(captured)]) - threshold;
+  if (swap < 0)
+    return false;
+
+  swap = PieceValue[type_of(piece_at(from))] - swap;
+  if (swap <= 0)
+    return true;
+
+  BitBoard occupied = pieces() ^ from ^ to;
+  BitBoard attackers = attacked_by(to, occupied);
+  BitBoard stm_attackers, bb;
+
+  Color stm = get_side_to_move();
+  int res = 1;
+
+  while (true) {
+    stm = ~stm;
+    attackers &= occupied;
+
+    if (!(stm_attackers = attackers & pieces(stm)))
+      break;
+
+    // Pinned pieces cannot join the exchange while their pinner is on board
+    if (get_pinners(~stm) & occupied)
+      stm_attackers &= ~get_blockers(stm);
+
+    if (!stm_attackers)
+      break;
+
+    res ^= 1;
+
+    if ((bb = stm_attackers & pieces(PAWN))) {
+      if ((swap = PAWN_VALUE - swap) < res)
+        break;
+      occupied ^= lsb(bb);
+      attackers |= attacks_bb(to, BISHOP, occupied) &
+                   (pieces(BISHOP) | pieces(QUEEN));
+
+    } else if ((bb = stm_attackers & pieces(KNIGHT))) {
+      if ((swap = KNIGHT_VALUE - swap) < res)
+        break;
+      occupied ^= lsb(bb);
+
+    } else if ((bb = stm_attackers & pieces(BISHOP))) {
+      if ((swap = BISHOP_VALUE - swap) < res)
+        break;
+      occupied ^= lsb(bb);
+      attackers |= attacks_bb(to, BISHOP, occupied) &
+                   (pieces(BISHOP) | pieces(QUEEN));
+
+    } else if ((bb = stm_attackers & pieces(ROOK))) {
+      if ((swap = ROOK_VALUE - swap) < res)
+        break;
+      occupied ^= lsb(bb);
+      attackers |=
+          attacks_bb(to, ROOK, occupied) & (pieces(ROOK) | pieces(QUEEN));
+
+    } else if ((bb = stm_attackers & pieces(QUEEN))) {
+      if ((swap = QUEEN_VALUE - swap) < res)
+        break;
+      occupied ^= lsb(bb);
+      attackers |= (attacks_bb(to, BISHOP, occupied) &
+                    (pieces(BISHOP) | pieces(QUEEN))) |
+                   (attacks_bb(to, ROOK, occupied) &
+                    (pieces(ROOK) | pieces(QUEEN)));
+
+    } else {
+      // The king can only capture if the opponent has no attackers left
+      return (attackers & ~pieces(stm)) ? res ^ 1 : res;
+    }
+  }
+
+  return bool(res);
+}
+
 template <PieceType Pt>
 BitBoard Position::attacks_by(Color c) const {
   BitBoard piece_bb = pieces(c, Pt);
@@ -494,6 +687,8 @@ void Position::update_pinners_blockers() {
 
     BitBoard blockers_bb = 0;
     BitBoard pinners_bb = 0;
+    BitBoard pin_hv_bb = 0;
+    BitBoard pin_diag_bb = 0;
 
     BitBoard occ = pieces();
     BitBoard st_sliding_occ = pieces(them, ROOK) | pieces(them, QUEEN);
@@ -516,6 +711,9 @@ void Position::update_pinners_blockers() {
           (popcount(blocker_candidate_bb) == 1)) {
         pinners_bb |= pinner_candidate_bb;
         blockers_bb |= blocker_candidate_bb;
+
+        if (blocker_candidate_bb & pieces(us))
+          pin_hv_bb |= king_ray_atk;
       }
     }
 
@@ -530,14 +728,103 @@ void Position::update_pinners_blockers() {
           (popcount(blocker_candidate_bb) == 1)) {
         pinners_bb |= pinner_candidate_bb;
         blockers_bb |= blocker_candidate_bb;
+
+        if (blocker_candidate_bb & pieces(us))
+          pin_diag_bb |= king_ray_atk;
       }
     }
 
     st->blockers[us] = blockers_bb;
     st->pinners[them] = pinners_bb;
+    st->pin_hv_mask[us] = pin_hv_bb;
+    st->pin_diag_mask[us] = pin_diag_bb;
   }
 }
 
+// Castling rights that are lost once a piece moves from or to the square
+inline CastlingRights castling_rights_of(Square s) {
+  switch (s) {
+    case SQ_H1:
+      return WHITE_OO;
+    case SQ_A1:
+      return WHITE_OOO;
+    case SQ_H8:
+      return BLACK_OO;
+    case SQ_A8:
+      return BLACK_OOO;
+    default:
+      return NO_CASTLING;
+  }
+}
+
+/*
+  Computes the zobrist key of the position after a pseudo legal move without
+  making it, so that the transposition table entry can be prefetched while
+  the move is being made. Must agree with the key updates in make_move.
+*/
+Key Position::key_after(Move m) const {
+  Square from = m.from_sq();
+  Square to = m.to_sq();
+  MoveType move_type = m.type_of();
+
+  Piece p = piece_at(from);
+  Color us = st->side_to_move;
+  Color them = ~us;
+
+  Key key = st->zobrist_key ^ Zobrist::black_to_move;
+  CastlingRights lost = NO_CASTLING;
+
+  if (st->can_ep)
+    key ^= Zobrist::ep_file[file_of(st->ep_square)];
+
+  if (move_type == CASTLING) {
+    bool king_side = to > from;
+    Square rfrom = square_of(king_side ? FILE_H : FILE_A, rank_of(from));
+    Square rto = square_of(king_side ? FILE_F : FILE_D, rank_of(from));
+
+    key ^= Zobrist::psq[p][from] ^ Zobrist::psq[p][to];
+    key ^= Zobrist::psq[piece_of(us, ROOK)][rfrom] ^
+           Zobrist::psq[piece_of(us, ROOK)][rto];
+
+    lost = us & ANY_CASTLING;
+
+  } else if (move_type == ENPASSANT) {
+    Square capture_sq = Square(to + (us == WHITE ? -8 : 8));
+
+    key ^= Zobrist::psq[piece_of(them, PAWN)][capture_sq];
+    key ^= Zobrist::psq[p][from] ^ Zobrist::psq[p][to];
+
+  } else {
+    Piece capture_piece = piece_at(to);
+    Piece to_piece =
+        move_type == PROMOTION ? piece_of(us, m.promotion_type()) : p;
+
+    if (capture_piece != NO_PIECE)
+      key ^= Zobrist::psq[capture_piece][to];
+
+    key ^= Zobrist::psq[p][from] ^ Zobrist::psq[to_piece][to];
+
+    lost = castling_rights_of(from) | castling_rights_of(to);
+
+    if (type_of(p) == KING)
+      lost = lost | (us & ANY_CASTLING);
+
+    // A double push only sets the en passant file if it can be captured
+    if (type_of(p) == PAWN && (to - from == 16 || from - to == 16)) {
+      Square ep_square = Square((from + to) / 2);
+
+      if (pawn_attacks_bb(us, ep_square) & pieces(them, PAWN))
+        key ^= Zobrist::ep_file[file_of(to)];
+    }
+  }
+
+  for (int i = 0; i < 4; ++i)
+    if (st->castling_rights & lost & (WHITE_OO << i))
+      key ^= Zobrist::castling_rights[i];
+
+  return key;
+}
+
 void Position::make_move(Move m, StateInfo* new_st, bool gives_check) {
   Square from = m.from_sq();
   Square to = m.to_sq();
@@ -557,7 +844,20 @@ void Position::make_move(Move m, StateInfo* new_st, bool gives_check) {
   assert(p != NO_PIECE);
   assert(color_of(p) == us);
 
-  // 1. Make move
+  // 1. Link the new state. Only the incrementally updated prefix is copied,
+  // every other field is set below. The pieces are moved on the new state, so
+  // that set_piece and remove_piece update its material and scores.
+  StateInfo* old_st = get_state();
+
+  copy_state_prefix(new_st, old_st);
+
+  old_st->next = new_st;
+  new_st->prev = old_st;
+  new_st->next = nullptr;
+
+  st = new_st;
+
+  // 2. Make move
   if (move_type == CASTLING) {
     cr = file_of(to) - file_of(from) > 0
              ? (us == WHITE ? WHITE_OO : BLACK_OO)
@@ -608,29 +908,14 @@ void Position::make_move(Move m, StateInfo* new_st, bool gives_check) {
     return;
   }
 
-  // 2. Update State
-  std::memset(new_st, 0, sizeof(StateInfo));
-
-  StateInfo* old_st = get_state();
-
-  copy_state(new_st, old_st);
-
-  old_st->next = new_st;
-  new_st->prev = old_st;
-  new_st->next = nullptr;
-
-  new_st->zobrist_key = old_st->zobrist_key;
-  new_st->pawn_key = old_st->pawn_key;
-  new_st->minor_key = old_st->minor_key;
-  new_st->major_key = old_st->major_key;
-
+  // 3. Update State
   new_st->previous_move = m;
   new_st->fifty_move_counter += 1;
   new_st->plies_from_start += 1;
+  new_st->plies_from_null += 1;
   new_st->captured_piece = capture_piece;
   new_st->repetition = 0;
   new_st->side_to_move = them;
-  new_st->castling_rights = old_st->castling_rights;
 
   new_st->can_ep = false;
   new_st->ep_square = SQ_NONE;
@@ -638,7 +923,42 @@ void Position::make_move(Move m, StateInfo* new_st, bool gives_check) {
   if (old_st->can_ep)
     new_st->zobrist_key ^= Zobrist::ep_file[file_of(old_st->ep_square)];
 
-  st = new_st;
+  // Pieces changed by the move, the castling rook is added below
+  DirtyPiece& dp = new_st->dirty_piece;
+
+  dp.dirty_num = 1;
+  dp.piece[0] = p;
+  dp.from[0] = from;
+  dp.to[0] = move_type == PROMOTION ? SQ_NONE : to;
+
+  if (capture_piece != NO_PIECE) {
+    dp.piece[dp.dirty_num] = capture_piece;
+    dp.from[dp.dirty_num] =
+        move_type == ENPASSANT ? Square(to + (us == WHITE ? -8 : 8)) : to;
+    dp.to[dp.dirty_num++] = SQ_NONE;
+  }
+
+  if (move_type == PROMOTION) {
+    dp.piece[dp.dirty_num] = piece_of(us, promotion_type);
+    dp.from[dp.dirty_num] = SQ_NONE;
+    dp.to[dp.dirty_num++] = to;
+  }
+
+  // Pieces are already moved, so the counts are the ones after the move
+  if (capture_piece != NO_PIECE)
+    new_st->material_key ^=
+        Zobrist::psq[capture_piece]
+                    [popcount(pieces(them, type_of(capture_piece)))];
+
+  if (move_type == PROMOTION) {
+    new_st->material_key ^=
+        Zobrist::psq[p][popcount(pieces(us, PAWN))] ^
+        Zobrist::psq[piece_of(us, promotion_type)]
+                    [popcount(pieces(us, promotion_type)) - 1];
+  }
+
+  new_st->accumulator.computed[WHITE] = false;
+  new_st->accumulator.computed[BLACK] = false;
 
   set_check_squares();
 
@@ -675,6 +995,11 @@ void Position::make_move(Move m, StateInfo* new_st, bool gives_check) {
         return;
     }
 
+    dp.piece[1] = piece_of(us, ROOK);
+    dp.from[1] = rfrom;
+    dp.to[1] = rto;
+    dp.dirty_num = 2;
+
     st->zobrist_key ^= Zobrist::psq[piece_of(us, KING)][from];
     st->zobrist_key ^= Zobrist::psq[piece_of(us, KING)][to];
     st->zobrist_key ^= Zobrist::psq[piece_of(us, ROOK)][rfrom];
@@ -754,6 +1079,8 @@ void Position::make_move(Move m, StateInfo* new_st, bool gives_check) {
     st->zobrist_key ^= Zobrist::psq[p][from];
     st->zobrist_key ^= Zobrist::psq[promotion_piece][to];
 
+    st->pawn_key ^= Zobrist::psq[p][from];
+
     switch (type_of(promotion_piece)) {
       case KNIGHT:
       case BISHOP:
@@ -955,17 +1282,14 @@ void Position::unmake_move() {
   PieceType pt = type_of(piece_at(to));
   Piece captured_piece = st->captured_piece;
 
-  // 1. Revert state:
   if (st->prev == nullptr) {
     std::cerr << "Error: No previous states." << std::endl;
     return;
   }
 
-  StateInfo* prev = st->prev;
-  st = prev;
-  st->next = nullptr;
-
-  // 2. Reverse previous move:
+  // 1. Reverse previous move. The pieces are put back while the state of the
+  // move is still current, so the scores of the previous state stay as they
+  // were.
   if (mt == CASTLING) {
     cr = file_of(to) - file_of(from) > 0
              ? (them == WHITE ? WHITE_OO : BLACK_OO)
@@ -1011,6 +1335,10 @@ void Position::unmake_move() {
     std::cerr << "Error: Unknown MoveType." << std::endl;
     return;
   }
+
+  // 2. Revert state
+  st = st->prev;
+  st->next = nullptr;
 }
 
 void Position::undo_castling(Color c, Square to, Square from, Square rto,
@@ -1049,12 +1377,74 @@ void Position::undo_promotion(Color c, Square to, Square from) {
   set_piece(c, PAWN, from);
 }
 
+/*
+  Passes the turn without moving a piece. Only the StateInfo changes: side to
+  move, en passant square and the zobrist key. The board, and therefore the
+  pinners and blockers, stay the same.
+*/
+void Position::make_null_move(StateInfo* new_st) {
+  assert(!is_in_check());
+
+  StateInfo* old_st = get_state();
+
+  copy_state_prefix(new_st, old_st);
+
+  old_st->next = new_st;
+  new_st->prev = old_st;
+  new_st->next = nullptr;
+
+  std::copy(std::begin(old_st->blockers), std::end(old_st->blockers),
+            std::begin(new_st->blockers));
+  std::copy(std::begin(old_st->pinners), std::end(old_st->pinners),
+            std::begin(new_st->pinners));
+  std::copy(std::begin(old_st->pin_hv_mask), std::end(old_st->pin_hv_mask),
+            std::begin(new_st->pin_hv_mask));
+  std::copy(std::begin(old_st->pin_diag_mask), std::end(old_st->pin_diag_mask),
+            std::begin(new_st->pin_diag_mask));
+
+  if (old_st->can_ep)
+    new_st->zobrist_key ^= Zobrist::ep_file[file_of(old_st->ep_square)];
+
+  new_st->zobrist_key ^= Zobrist::black_to_move;
+
+  new_st->previous_move = Move::null_move();
+  new_st->captured_piece = NO_PIECE;
+  new_st->fifty_move_counter += 1;
+  new_st->plies_from_start += 1;
+  new_st->plies_from_null = 0;
+  new_st->repetition = 0;
+  new_st->side_to_move = ~old_st->side_to_move;
+
+  new_st->can_ep = false;
+  new_st->ep_square = SQ_NONE;
+
+  new_st->dirty_piece.dirty_num = 0;
+  new_st->accumulator.computed[WHITE] = false;
+  new_st->accumulator.computed[BLACK] = false;
+
+  new_st->in_check = false;
+  new_st->checkersBB = 0;
+
+  st = new_st;
+
+  set_check_squares();
+}
+
+void Position::unmake_null_move() {
+  assert(st->prev != nullptr);
+  assert(st->previous_move.is_nullmove());
+
+  st = st->prev;
+  st->next = nullptr;
+}
+
 bool Position::update_repetition() {
   Key new_key = st->zobrist_key;
   StateInfo* curr = st;
   int new_repetition = 0;
 
-  int end = st->fifty_move_counter;
+  // Positions before a null move cannot repeat the current one
+  int end = std::min(st->fifty_move_counter, st->plies_from_null);
 
   if (curr && curr->prev && (curr = curr->prev->prev)) {
     for (int i = 2; i < end; i += 2) {
@@ -1,9 +1,41 @@
+#include <cmath>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+
 #include "search.h"
 
+#include "misc.h"
 #include "thread.h"
+#include "uci.h"
 
 namespace Juujfish {
 
+// Late move reductions indexed by [depth][move_count]
+Depth Reductions[MAX_PLY][MAX_MOVES];
+
+// Mate scores are stored in the transposition table relative to the node
+// instead of the root, so that they stay valid when reached at another ply
+inline Value value_to_tt(Value v, int ply) {
+  return v >= VALUE_MATE - MAX_PLY    ? v + ply
+         : v <= -VALUE_MATE + MAX_PLY ? v - ply
+                                      : v;
+}
+
+inline Value value_from_tt(Value v, int ply) {
+  return v == VALUE_NONE                ? VALUE_NONE
+         : v >= VALUE_MATE - MAX_PLY    ? v - ply
+         : v <= -VALUE_MATE + MAX_PLY ? v + ply
+                                      : v;
+}
+
+void Search::init() {
+  for (int d = 1; d < MAX_PLY; ++d)
+    for (int mc = 1; mc < MAX_MOVES; ++mc)
+      Reductions[d][mc] = Depth(0.75 + std::log(d) * std::log(mc) / 2.25);
+}
+
 #if 0
 
 Value Search::Worker::iterative_deepening(Position &pos) {
@@ -53,7 +85,6 @@ Value Search::Worker::search(Position& pos, Value alpha, Value beta,
   }
 
   StateInfo new_st;
-  memset(&new_st, 0, sizeof(new_st));
 
   MoveOrderer mo(pos, table_hit ? table_data.move : Move::null_move(), ply,
                  &killer, &history, &butterfly);
@@ -130,6 +161,7 @@ Search::Worker::Worker(ThreadPool& tp, size_t thread_id)
     : thread_pool(tp), _thread_id(thread_id) {
 
   nodes = 0;
+  nmp_min_ply = 0;
 
   killer.init();
   history.init();
@@ -139,12 +171,16 @@ Search::Worker::Worker(ThreadPool& tp, size_t thread_id)
 void Search::Worker::clear() {
   nodes = 0;
   root_depth = 0;
+  nmp_min_ply = 0;
   root_moves.clear();
   memset(pv, 0, sizeof(pv));
 
   killer.clear();
   history.clear();
   butterfly.clear();
+
+  pawn_table.clear();
+  material_table.clear();
 }
 
 Move Search::Worker::get_best_move() const {
@@ -157,35 +193,33 @@ void Search::Worker::start_searching() {
     return;
   }
 
-
+  tm.init(limits, root_pos.get_side_to_move());
+  calls_cnt = CHECK_TIME_INTERVAL;
 
   tt->new_search();
-  thread_pool.start_searching();
 
-  iterative_deepening();
+  if (root_moves.empty()) {
+    std::cout << "info depth 0 score "
+              << UCI::value(root_pos.is_in_check() ? -VALUE_MATE : VALUE_DRAW)
+              << std::endl;
+  } else {
+    thread_pool.start_searching();
+    iterative_deepening();
+  }
+
+  // While pondering or in infinite mode the best move is only sent once the
+  // GUI asks for it with stop or ponderhit
+  while (!thread_pool.stop && (thread_pool.ponder || limits.infinite))
+    std::this_thread::yield();
 
   thread_pool.stop = true;
   thread_pool.wait_for_all_threads();
 
-  std::sort(root_moves.begin(), root_moves.end());  // Potentially not necessary
-
   /*
       For now, take the strict 0-th thread's PV as the final result.
       In the future, we want to consider the deepest, minimum score when comparing moves in root_moves.
     */
-
-  // get_best_move();  // Temporary, eventually return this to GUI
-
-  // for (auto& rm : root_moves)
-  //   std::cout << moveToString(rm.move) << ": " << (int) rm.score << std::endl;
-
-  // for (int i = 0; i < root_depth; i++) {
-  //   std::cout << moveToString(pv[i]) << " ";
-  // }
-  // std::cout << std::endl;
-    
-
-  // std::cout << "Best move: " << moveToString(get_best_move()) << std::endl;
+  print_best_move();
 }
 
 void Search::Worker::iterative_deepening() {
@@ -198,11 +232,16 @@ void Search::Worker::iterative_deepening() {
   Move prev_pv[MAX_MOVES];
   Move prev_move;
 
+  // Time management state of the main thread
+  Move last_best_move = Move::null_move();
+  int best_move_stability = 0;
+  Value last_iteration_score = VALUE_ZERO;
+  TimePoint iteration_start = 0;
+
   while (++root_depth < MAX_PLY && !thread_pool.stop) {
 
-    if (is_mainthread() &&
-        root_depth > 8)  // Arbitrary depth limit for main thread
-      thread_pool.stop = true;
+    if (is_mainthread())
+      iteration_start = tm.elapsed();
 
     delta = 5 + root_moves[0].mean_score_squared / 10000;
     prev_score = root_moves[0].score;
@@ -213,9 +252,11 @@ void Search::Worker::iterative_deepening() {
     copy_pv(prev_pv, pv);
 
     while (true) {
-      nodes = 0;
       score = Search::Worker::search<RootNode>(root_pos, alpha, beta,
-                                               root_depth, false);
+                                               root_depth, 0, false);
+
+      if (thread_pool.stop)
+        break;
 
       if (score <= alpha)
         alpha = std::max(alpha - delta, -VALUE_INFINITE);
@@ -252,18 +293,70 @@ void Search::Worker::iterative_deepening() {
           (root_moves[0].mean_score_squared * (root_depth - 1) +
            score * score) /
           root_depth;
+    }
+
+    if (!is_mainthread() || thread_pool.stop)
+      continue;
+
+    print_info(root_depth, score);
+
+    // Stop at the iteration boundary once a depth or mate limit is reached.
+    // While pondering the stop is deferred until the ponderhit.
+    bool limit_reached =
+        (limits.depth && root_depth >= limits.depth) ||
+        (limits.mate && score >= VALUE_MATE - 2 * limits.mate);
+
+    if (limits.use_time_management() && !limit_reached) {
+      best_move_stability =
+          pv[0] == last_best_move ? best_move_stability + 1 : 0;
+      last_best_move = pv[0];
 
-      // std::cout << "best move at depth " << (int) root_depth << ": "
-      //           << moveToString(root_moves[0].move) << " score: " << (int) score
-      //           << " nodes: " << nodes.load() << std::endl;
+      // Spend more time while the best move changes or the score drops
+      double instability = std::max(0.5, 1.5 - 0.2 * best_move_stability);
+      double falling_eval = std::clamp(
+          1.0 + (last_iteration_score - score) / 200.0, 0.75, 1.5);
+
+      TimePoint elapsed = tm.elapsed();
+      TimePoint iteration_time = elapsed - iteration_start;
+      TimePoint total_time = tm.optimum() * instability * falling_eval;
+
+      // Assume the next iteration takes at least twice as long as this one
+      if (elapsed > total_time || elapsed + 2 * iteration_time > tm.maximum())
+        limit_reached = true;
+
+      last_iteration_score = score;
+    }
+
+    if (limit_reached) {
+      if (thread_pool.ponder)
+        thread_pool.stop_on_ponderhit = true;
+      else
+        thread_pool.stop = true;
     }
   }
 }
 
 
+// Called by the main thread to stop the search once the hard limits are hit
+void Search::Worker::check_time() {
+  if (--calls_cnt > 0)
+    return;
+
+  calls_cnt = CHECK_TIME_INTERVAL;
+
+  // The clock only starts to matter once the ponder move is played
+  if (thread_pool.ponder)
+    return;
+
+  if (((limits.use_time_management() || limits.movetime) &&
+       tm.elapsed() >= tm.maximum()) ||
+      (limits.nodes && thread_pool.nodes_searched() >= limits.nodes))
+    thread_pool.stop = true;
+}
+
 template <NodeType Nt>
 Value Search::Worker::search(Position& pos, Value alpha, Value beta,
-                             Depth depth, bool cut_node) {
+                             Depth depth, int ply, bool cut_node) {
 
   // STEP 1: Intial Declearations and Node setup
   constexpr bool pv_node = (Nt != NonPV);
@@ -275,69 +368,160 @@ Value Search::Worker::search(Position& pos, Value alpha, Value beta,
   Move tt_move;
   Move best_move = Move::null_move();
 
-  Color us = pos.get_side_to_move();
+  Value old_alpha = alpha;
+  Value static_eval = VALUE_NONE;
 
-  int ply = root_depth - depth;
+  Color us = pos.get_side_to_move();
+  bool in_check = pos.is_in_check();
 
   // STEP 2: Check thread_pool.stop and for draw by repetition or 50-move rule
+  if (is_mainthread())
+    check_time();
+
   if (thread_pool.stop.load(std::memory_order_relaxed) || pos.is_draw())
     return VALUE_DRAW;
 
-  // STEP 3: Transposition Lookup
-  auto [table_hit, table_data, table_writer] =
-      tt->probe(pos.get_key(), pos.generate_secondary_key());
+  // STEP 3: Resolve captures with quiescence search at the horizon
+  if (depth <= 0)
+    return qsearch<pv_node ? PV : NonPV>(pos, alpha, beta, ply);
+
+  // STEP 4: Transposition Lookup, cut off in non-PV nodes if the stored bound
+  // proves the result
+  auto [table_hit, table_data, table_writer] = tt->probe(pos.get_key());
+
+  Value tt_value =
+      table_hit ? value_from_tt(table_data.value, ply) : VALUE_NONE;
+  tt_move = table_hit ? table_data.move : Move::null_move();
+
+  if (!pv_node && table_hit && table_data.depth >= depth &&
+      tt_value != VALUE_NONE &&
+      (table_data.bound & (tt_value >= beta ? BOUND_LOWER : BOUND_UPPER)) &&
+      pos.get_fifty_move_counter() < 90)
+    return tt_value;
+
+  // The static evaluation is cached in the table next to the search result
+  if (!in_check) {
+    static_eval =
+        table_hit && table_data.eval != VALUE_NONE
+            ? table_data.eval
+            : (us == WHITE ? evaluate(pos, pawn_table, material_table)
+                           : -evaluate(pos, pawn_table, material_table));
+  }
 
-  if (!root_node && table_hit && table_data.depth >= depth &&
-      (table_data.score >= beta) &&
-      (!table_data.move.is_nullmove())) {
 
-    tt_move = table_data.move;
+  // STEP 5: Null Move Pruning with verification search at high depth
+  if (!pv_node && !in_check && depth >= NMP_MIN_DEPTH &&
+      ply >= nmp_min_ply && beta > -VALUE_MATE + MAX_PLY &&
+      !pos.get_state()->previous_move.is_nullmove() &&
+      pos.non_pawn_material(us)) {
+    if (static_eval >= beta) {
+      Depth R = NMP_BASE_REDUCTION + depth / 4 +
+                std::min((static_eval - beta) / 200, 3);
 
-    if (pos.get_fifty_move_counter() < 90)
-      return table_data.score;
-  }
+      StateInfo null_st;
 
-  // STEP 4: Evaluate if depth == 0
-  if (depth == 0)
-    return us == WHITE ? evaluate(pos) : -evaluate(pos);
+      pos.make_null_move(&null_st);
+      Value null_score = -search<NonPV>(pos, -beta, -beta + 1, depth - R,
+                                        ply + 1, !cut_node);
+      pos.unmake_null_move();
+
+      if (thread_pool.stop.load(std::memory_order_relaxed))
+        return VALUE_DRAW;
+
+      if (null_score >= beta) {
+        // Do not return unproven mate scores
+        if (null_score >= VALUE_MATE - MAX_PLY)
+          null_score = beta;
+
+        if (nmp_min_ply || depth < NMP_VERIFICATION_DEPTH)
+          return null_score;
+
+        // Verify with null move disabled for the first part of the subtree
+        nmp_min_ply = ply + 3 * (depth - R) / 4;
+
+        Value verified_score =
+            search<NonPV>(pos, beta - 1, beta, depth - R, ply, false);
+
+        nmp_min_ply = 0;
 
+        if (verified_score >= beta)
+          return null_score;
+      }
+    }
+  }
 
   // Start Moves Loop
-  MoveOrderer mo(pos, table_hit ? tt_move : Move::null_move(),
-                 root_depth - depth, &killer, &history, &butterfly);
+  MoveOrderer mo(pos, tt_move, ply, &killer, &history, &butterfly);
 
   Move curr_move;
 
   StateInfo new_st;
-  memset(&new_st, 0, sizeof(new_st));
 
   int move_count = 0;
   while (!(curr_move = mo.next()).is_nullmove()) {
-    /* 
-      Cannot 100% trust the transposition table move to be uncorrupted or not a collision.
-      So we must verify that it is at least pseudo-legal before trying it first. 
-    */
-    if (curr_move == tt_move && !pos.pseudo_legal(curr_move))
-      continue;
+    bool gives_check = pos.gives_check(curr_move);
+    bool capture =
+        pos.is_capture(curr_move) || curr_move.type_of() == PROMOTION;
+
+    // STEP 6: Shallow Depth Pruning of moves losing material in the exchange
+    if (!root_node && depth <= SEE_PRUNING_DEPTH &&
+        best_score > -VALUE_MATE + MAX_PLY) {
+      if (capture || gives_check) {
+        if (!pos.see_ge(curr_move, -SEE_CAPTURE_MARGIN * depth))
+          continue;
+      } else if (!pos.see_ge(curr_move, -SEE_QUIET_MARGIN * depth * depth))
+        continue;
+    }
 
-    if (!pos.legal(curr_move))
-      continue;
+    Depth new_depth = depth - 1;
+    PieceType moved_pt = type_of(pos.piece_at(curr_move.from_sq()));
+    int move_history = history.lookup(curr_move, us, moved_pt) /
+                       butterfly.lookup(curr_move, us);
 
-    // STEP 5: Make Move and update move_count
-    pos.make_move(curr_move, &new_st, pos.gives_check(curr_move));
+    // STEP 7: Make Move and update move_count, the child's table entry is
+    // prefetched so that its load overlaps with the move
+    tt->prefetch(pos.key_after(curr_move));
+    pos.make_move(curr_move, &new_st, gives_check);
     move_count++;
 
-    // STEP 6: Null Window Search
-    if (!pv_node || move_count > 1) {
-      score = -search<NonPV>(pos, -(alpha + 1), -alpha, depth - 1, !cut_node);
+    // STEP 8: Late Move Reductions, or Null Window Search when not reduced
+    if (depth >= LMR_MIN_DEPTH && move_count > 1 + root_node && !capture &&
+        !in_check && !gives_check) {
+      Depth r = Reductions[std::min(depth, MAX_PLY - 1)]
+                          [std::min(move_count, MAX_MOVES - 1)];
+
+      r += cut_node;
+      r -= pv_node;
+
+      // Reduce killers less and moves ranked as bad quiets more
+      if (mo.get_stage() == QUIET && killer.lookup(curr_move, ply))
+        r -= 1;
+      else if (mo.get_stage() == BAD_QUIET)
+        r += 1;
+
+      r -= std::min(move_history / LMR_HISTORY_DIVISOR, 2);
+
+      Depth reduced_depth = std::clamp(new_depth - r, 1, new_depth);
+
+      score = -search<NonPV>(pos, -(alpha + 1), -alpha, reduced_depth,
+                             ply + 1, true);
+
+      // Re-search at full depth if the reduced search fails high
+      if (score > alpha && reduced_depth < new_depth)
+        score = -search<NonPV>(pos, -(alpha + 1), -alpha, new_depth, ply + 1,
+                               !cut_node);
+
+    } else if (!pv_node || move_count > 1) {
+      score = -search<NonPV>(pos, -(alpha + 1), -alpha, new_depth, ply + 1,
+                             !cut_node);
     }
 
-    // STEP 7: Full Window Search if necessary
+    // STEP 9: Full Window Search if necessary
     if (pv_node && (score > alpha || move_count == 1)) {
-      score = -search<PV>(pos, -beta, -alpha, depth - 1, false);
+      score = -search<PV>(pos, -beta, -alpha, new_depth, ply + 1, false);
     }
 
-    // STEP 8: Unmake Move and Update best_score, best_move, alpha, and heuristics
+    // STEP 10: Unmake Move and Update best_score, best_move, alpha, and heuristics
     pos.unmake_move();
     nodes++;
 
@@ -374,24 +558,26 @@ Value Search::Worker::search(Position& pos, Value alpha, Value beta,
     }
   }  // End Moves Loop
 
-  // STEP 9: Handle No Moves Case (Checkmate or Stalemate)
+  // STEP 11: Handle No Moves Case (Checkmate or Stalemate)
   if (move_count == 0) {
-    if (pos.is_in_check())
-      best_score = -(VALUE_MATE - (root_depth - depth));
+    if (in_check)
+      best_score = -(VALUE_MATE - ply);
     else
       best_score = VALUE_DRAW;
   }
 
-  // STEP 10: Store in Transposition Table
+  // STEP 12: Store in Transposition Table, the bound is relative to the
+  // window the node was searched with
   if (!root_node && !best_move.is_nullmove()) {
-    table_writer.write(pos.get_key(), pos.generate_secondary_key(), depth,
-                       best_score <= alpha
-                           ? BOUND_UPPER
-                           : (best_score >= beta ? BOUND_LOWER : BOUND_EXACT),
-                       best_score, best_move);
+    Bound bound = best_score >= beta                  ? BOUND_LOWER
+                  : pv_node && best_score > old_alpha ? BOUND_EXACT
+                                                      : BOUND_UPPER;
+
+    table_writer.write(pos.get_key(), depth, bound,
+                       value_to_tt(best_score, ply), static_eval, best_move);
   }
 
-  // STEP 11: Update PV
+  // STEP 13: Update PV
   if (!best_move.is_nullmove() && pv_node && best_score >= alpha) {
     pv[ply] = best_move;
   }
@@ -399,6 +585,181 @@ Value Search::Worker::search(Position& pos, Value alpha, Value beta,
   return best_score;
 }
 
+template <NodeType Nt>
+Value Search::Worker::qsearch(Position& pos, Value alpha, Value beta, int ply) {
+  static_assert(Nt != RootNode, "Error: Quiescence search has no root node.");
+
+  // STEP 1: Initial Declarations and Node setup
+  constexpr bool pv_node = (Nt == PV);
+
+  Value best_score, stand_pat, score;
+  Value static_eval = VALUE_NONE;
+
+  Move best_move = Move::null_move();
+
+  Color us = pos.get_side_to_move();
+  bool in_check = pos.is_in_check();
+
+  // STEP 2: Check thread_pool.stop and for draw by repetition or 50-move rule
+  if (thread_pool.stop.load(std::memory_order_relaxed) || pos.is_draw())
+    return VALUE_DRAW;
+
+  if (ply >= MAX_PLY - 1)
+    return in_check
+               ? VALUE_DRAW
+               : (us == WHITE ? evaluate(pos, pawn_table, material_table)
+                              : -evaluate(pos, pawn_table, material_table));
+
+  // STEP 3: Transposition Lookup, any stored depth is deep enough here
+  auto [table_hit, table_data, table_writer] = tt->probe(pos.get_key());
+
+  Value tt_value =
+      table_hit ? value_from_tt(table_data.value, ply) : VALUE_NONE;
+  Move tt_move = table_hit ? table_data.move : Move::null_move();
+
+  if (!pv_node && table_hit && table_data.depth >= DEPTH_QS &&
+      tt_value != VALUE_NONE &&
+      (table_data.bound & (tt_value >= beta ? BOUND_LOWER : BOUND_UPPER)))
+    return tt_value;
+
+  // STEP 4: Stand pat, unless in check where every evasion must be tried
+  if (in_check) {
+    best_score = stand_pat = -VALUE_INFINITE;
+  } else {
+    static_eval =
+        table_hit && table_data.eval != VALUE_NONE
+            ? table_data.eval
+            : (us == WHITE ? evaluate(pos, pawn_table, material_table)
+                           : -evaluate(pos, pawn_table, material_table));
+
+    best_score = stand_pat = static_eval;
+
+    if (stand_pat >= beta) {
+      if (!table_hit)
+        table_writer.write(pos.get_key(), DEPTH_QS, BOUND_LOWER,
+                           value_to_tt(stand_pat, ply), static_eval,
+                           Move::null_move());
+      return stand_pat;
+    }
+
+    alpha = std::max(alpha, stand_pat);
+  }
+
+  // Start Moves Loop
+  MoveOrderer mo(pos, tt_move, ply, &killer, &history, &butterfly, true);
+
+  Move curr_move;
+
+  StateInfo new_st;
+
+  int move_count = 0;
+  while (!(curr_move = mo.next()).is_nullmove()) {
+    move_count++;
+
+    bool gives_check = pos.gives_check(curr_move);
+
+    // STEP 5: Delta and SEE Pruning, skip captures that cannot raise alpha
+    if (!in_check && !gives_check && curr_move.type_of() != PROMOTION) {
+      Value gain = curr_move.type_of() == ENPASSANT
+                       ? PAWN_VALUE
+                       : PieceValue[type_of(pos.piece_at(curr_move.to_sq()))];
+
+      if (stand_pat + gain + DELTA_MARGIN <= alpha)
+        continue;
+
+      if (!pos.see_ge(curr_move))
+        continue;
+    }
+
+    // STEP 6: Make Move, search and Unmake Move
+    tt->prefetch(pos.key_after(curr_move));
+    pos.make_move(curr_move, &new_st, gives_check);
+    score = -qsearch<Nt>(pos, -beta, -alpha, ply + 1);
+    pos.unmake_move();
+    nodes++;
+
+    // Exit loop if search is stopped
+    if (thread_pool.stop.load(std::memory_order_relaxed))
+      return VALUE_DRAW;
+
+    // STEP 7: Update best_score, best_move and alpha
+    if (score > best_score) {
+      best_score = score;
+
+      if (score > alpha) {
+        alpha = score;
+        best_move = curr_move;
+
+        if (score >= beta)
+          break;
+      }
+    }
+  }  // End Moves Loop
+
+  // STEP 8: Checkmate if in check and no evasion exists
+  if (in_check && move_count == 0)
+    return -(VALUE_MATE - ply);
+
+  // STEP 9: Store in Transposition Table
+  table_writer.write(pos.get_key(), DEPTH_QS,
+                     best_score >= beta ? BOUND_LOWER : BOUND_UPPER,
+                     value_to_tt(best_score, ply), static_eval, best_move);
+
+  return best_score;
+}
+
+// Follows the PV from the root for as long as its moves stay legal
+std::vector<Move> Search::Worker::principal_variation() const {
+  std::vector<Move> line;
+  std::deque<StateInfo> states(1);
+
+  Position pos;
+  pos.set(root_pos.fen(), &states.back());
+
+  for (int i = 0; i < root_depth && !pv[i].is_nullmove(); ++i) {
+    if (!MoveList<LEGAL>(pos).contains(pv[i]))
+      break;
+
+    line.push_back(pv[i]);
+    states.emplace_back();
+    pos.make_move(pv[i], &states.back(), pos.gives_check(pv[i]));
+  }
+
+  return line;
+}
+
+void Search::Worker::print_info(Depth depth, Value score) const {
+  TimePoint elapsed = tm.elapsed();
+  std::uint64_t nodes_searched = thread_pool.nodes_searched();
+
+  std::string info = "info depth " + std::to_string(depth) + " score " +
+                     UCI::value(score) + " nodes " +
+                     std::to_string(nodes_searched) + " nps " +
+                     std::to_string(nodes_searched * 1000 / (elapsed + 1)) +
+                     " time " + std::to_string(elapsed) + " pv";
+
+  for (Move m : principal_variation())
+    info += " " + moveToString(m);
+
+  std::cout << info << std::endl;
+}
+
+void Search::Worker::print_best_move() const {
+  std::vector<Move> line = principal_variation();
+
+  // Fall back to the best root move if no iteration has been completed
+  Move best_move = line.empty() ? root_moves.empty() ? Move::null_move()
+                                                     : root_moves[0].move
+                                : line[0];
+
+  std::string output = "bestmove " + UCI::move(best_move);
+
+  if (line.size() > 1)
+    output += " ponder " + UCI::move(line[1]);
+
+  std::cout << output << std::endl;
+}
+
 void Search::Worker::copy_pv(Move* dest, const Move* src) {
   for (int i = 0; i < MAX_MOVES; i++)
     dest[i] = src[i];
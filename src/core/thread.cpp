@@ -63,9 +63,10 @@ void Thread::loop() {
     if (!running)
       return;
 
+    // searching stays set until the job returns, so that
+    // wait_for_search_finish() blocks for the whole search
     std::function<void()> job = std::move(job_func);
     job_func = nullptr;
-    searching = false;
 
     lock.unlock();
 
@@ -78,6 +79,8 @@ void Thread::loop() {
 // Function implementations for ThreadPool class
 
 ThreadPool::ThreadPool(TranspositionTable* tt, int num_threads) {
+  stop = ponder = stop_on_ponderhit = false;
+
   threads.resize(num_threads);
   for (int thread_id = 0; thread_id < num_threads; ++thread_id)
     threads[thread_id] = std::make_unique<Thread>(*this, thread_id);
@@ -113,22 +116,24 @@ void ThreadPool::wait_for_all_threads() {
       thread->wait_for_search_finish();
 }
 
-void ThreadPool::start(Position& root_pos, StatesDequePtr& initial_states) {
+void ThreadPool::start(Position& root_pos, const StatesDequePtr& game_states,
+                       const SearchLimits& limits) {
   main_thread()->wait_for_search_finish();
-  stop = false;
+  stop = stop_on_ponderhit = false;
+  ponder = limits.ponder;
 
   RootMoves root_moves;
   for (const auto& m : MoveList<LEGAL>(root_pos))
     root_moves.emplace_back(m);
 
-  states = std::move(initial_states);
-
   for (auto&& thread : threads) {
     thread->worker->tt = _tt;
     thread->worker->root_moves = root_moves;
     thread->worker->root_depth = 0;
+    thread->worker->nodes = 0;
+    thread->worker->limits = limits;
     thread->worker->root_pos.set(root_pos.fen(), &thread->worker->root_state);
-    thread->worker->root_state = states->back();
+    thread->worker->root_state = game_states->back();
   }
 
   for (auto&& thread : threads)
@@ -137,6 +142,23 @@ void ThreadPool::start(Position& root_pos, StatesDequePtr& initial_states) {
   main_thread()->start_searching();
 }
 
+std::uint64_t ThreadPool::nodes_searched() const {
+  std::uint64_t nodes = 0;
+  for (auto&& thread : threads)
+    nodes += thread->worker->get_nodes();
+  return nodes;
+}
+
+void ThreadPool::run_on_thread(size_t thread_id, std::function<void()> job) {
+  assert(thread_id < threads.size());
+  threads[thread_id]->dispatch_job(std::move(job));
+}
+
+void ThreadPool::wait_on_thread(size_t thread_id) {
+  assert(thread_id < threads.size());
+  threads[thread_id]->wait_for_search_finish();
+}
+
 void ThreadPool::start_searching() {
   for (auto&& thread : threads)
     if (thread != threads.front())
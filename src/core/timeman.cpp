@@ -0,0 +1,37 @@
+#include <algorithm>
+
+#include "timeman.h"
+
+namespace Juujfish {
+
+void TimeManager::init(const SearchLimits& limits, Color us) {
+  start_time = limits.start_time;
+
+  if (limits.movetime) {
+    optimum_time = maximum_time =
+        std::max(limits.movetime - MOVE_OVERHEAD, TimePoint(1));
+    return;
+  }
+
+  if (!limits.use_time_management()) {
+    optimum_time = maximum_time = 0;
+    return;
+  }
+
+  TimePoint time_left = std::max(limits.time[us] - MOVE_OVERHEAD, TimePoint(1));
+
+  int moves_to_go = limits.movestogo
+                        ? std::min(limits.movestogo, DEFAULT_MOVES_TO_GO)
+                        : DEFAULT_MOVES_TO_GO;
+
+  // Spread the time left and the increments still to come over the moves to go
+  TimePoint total_time = time_left + limits.inc[us] * (moves_to_go - 1);
+
+  optimum_time = std::min(total_time / moves_to_go, time_left / 2);
+  maximum_time = std::min(optimum_time * MAX_TIME_RATIO, time_left * 4 / 5);
+
+  optimum_time = std::max(optimum_time, TimePoint(1));
+  maximum_time = std::max(maximum_time, optimum_time);
+}
+
+}  // namespace Juujfish
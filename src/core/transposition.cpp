@@ -1,82 +1,132 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <tuple>
 
 #include "transposition.h"
 
+#include "thread.h"
+
 namespace Juujfish {
 
-inline Key zobrist_to_index(Key zobrist_key) {
-  uint64_t mask = ((1ULL << HASH_SIZE) - 1) << 16;
-  return ((zobrist_key & mask) >> 16) / (BUCKET_SIZE * sizeof(TableEntry));
+void TranspositionTable::resize(size_t mb, ThreadPool& threads) {
+  free();
+
+  cluster_count =
+      std::max(mb, size_t(1)) * 1024 * 1024 / sizeof(TableCluster);
+
+  // Raw allocation, the zeroing is left to the threads in clear()
+  table = static_cast<TableCluster*>(
+      large_page_alloc(cluster_count * sizeof(TableCluster), large_page_mode));
+
+  if (!table) {
+    std::cerr << "Error: Failed to allocate " << mb
+              << " MB for the transposition table." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  clear(threads);
 }
 
-void TableEntry::save(Key zobrist_key, uint16_t second_key, int8_t depth,
-                      Bound b, uint8_t age, int16_t score, Move m) {
-  this->zobrist_key = zobrist_key;
-  this->second_key = second_key;
-  this->depth = depth;
+void TranspositionTable::clear(ThreadPool& threads) {
+  const size_t num_threads = threads.size();
 
-  bound_age = b << 6 + age;
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.run_on_thread(i, [this, i, num_threads]() {
+      const size_t stride = cluster_count / num_threads;
+      const size_t start = stride * i;
+      const size_t len =
+          i + 1 != num_threads ? stride : cluster_count - start;
+
+      std::memset(static_cast<void*>(&table[start]), 0,
+                  len * sizeof(TableCluster));
+    });
+  }
 
-  this->score = score;
-  move = m;
+  for (size_t i = 0; i < num_threads; ++i)
+    threads.wait_on_thread(i);
+
+  table_age = 0;
+}
+
+void TranspositionTable::free() {
+  large_page_free(table, cluster_count * sizeof(TableCluster), large_page_mode);
+
+  table = nullptr;
+  cluster_count = 0;
 }
 
-size_t TableBucket::find_index(Key zobrist_key, uint16_t second_key) const {
-  size_t idx = 0;
-  while (idx < BUCKET_SIZE && !(entries[idx].zobrist_key == zobrist_key &&
-                                entries[idx].second_key == second_key)) {
-    ++idx;
+void TableWriter::write(Key zobrist_key, Depth depth, Bound b, Value value,
+                        Value eval, Move m) {
+  const uint16_t key16 = uint16_t(zobrist_key);
+
+  uint64_t old_data = cluster->data[index].load(std::memory_order_relaxed);
+  uint16_t old_key16 = cluster->keys[index].load(std::memory_order_relaxed) ^
+                       TableEntry::fold(old_data);
+
+  TableEntry entry = TableEntry::unpack(old_data);
+
+  // Keep the old move when the same position is stored without one
+  if (m || key16 != old_key16)
+    entry.move16 = m.raw();
+
+  // Only overwrite the same position with exact or deeper results, or if the
+  // entry is from a previous search
+  if (b == BOUND_EXACT || key16 != old_key16 ||
+      depth - DEPTH_ENTRY_OFFSET + 2 > entry.depth8 || entry.get_age() != age) {
+    entry.depth8 = uint8_t(depth - DEPTH_ENTRY_OFFSET);
+    entry.bound_age = uint8_t(b << AGE_BITS | age);
+    entry.value16 = int16_t(value);
+    entry.eval16 = int16_t(eval);
   }
-  return idx;
+
+  uint64_t data = entry.pack();
+
+  cluster->data[index].store(data, std::memory_order_relaxed);
+  cluster->keys[index].store(key16 ^ TableEntry::fold(data),
+                             std::memory_order_relaxed);
 }
 
 std::tuple<bool, TableData, TableWriter> TranspositionTable::probe(
-    Key zobrist_key, uint16_t second_key) const {
-  TableBucket* bucket;
-  size_t entry_index;
-
-  size_t bucket_index = zobrist_to_index(zobrist_key);
-
-  assert(bucket_index < bucket_count &&
-         "Error: Bucket index is not less than Bucket count");
-
-  bucket = &table[bucket_index];
-  entry_index = bucket->find_index(zobrist_key, second_key);
-
-  TableEntry* entry = &bucket->entries[entry_index];
-
-  if (entry_index < BUCKET_SIZE && entry->is_occupied()) {
-    return std::make_tuple(true, TableData(entry),
-                           TableWriter(entry, this->table_age));
-  } else if ((entry_index = bucket->find_index(0, 0)) < BUCKET_SIZE) {
-    entry = &bucket->entries[entry_index];
-    return std::make_tuple(false, TableData(entry),
-                           TableWriter(entry, this->table_age));
-  } else {
-    
-    // Replacement:
-    entry = &bucket->entries[0];
-    TableEntry* replacement_entry = &bucket->entries[0];
-
-    int replacement_score = entry->get_depth() - relative_age(entry->get_age());
-    int new_age = this->table_age+1;
-
-    for (size_t i = 1; i < BUCKET_SIZE; ++i) {
-      entry = &bucket->entries[i];
-      new_age = std::max(new_age, entry->get_age()+1);
-      if (entry->is_occupied() &&
-          replacement_score >
-              (entry->get_depth() - relative_age(entry->get_age()))) {
-
-        replacement_score =
-            (entry->get_depth() - relative_age(entry->get_age()));
-        replacement_entry = entry;
-      }
-    }
+    Key zobrist_key) const {
+  size_t index = cluster_index(zobrist_key);
+
+  assert(index < cluster_count &&
+         "Error: Cluster index is not less than Cluster count");
+
+  TableCluster* const cluster = &table[index];
+  const uint16_t key16 = uint16_t(zobrist_key);
+
+  TableEntry entries[CLUSTER_SIZE];
+
+  for (size_t i = 0; i < CLUSTER_SIZE; ++i) {
+    uint64_t data = cluster->data[i].load(std::memory_order_relaxed);
+    uint16_t key = cluster->keys[i].load(std::memory_order_relaxed);
 
-    return std::make_tuple(false, TableData(replacement_entry),
-                           TableWriter(replacement_entry, new_age));
+    entries[i] = TableEntry::unpack(data);
+
+    // A torn entry fails the check like any other key mismatch
+    if ((key ^ TableEntry::fold(data)) == key16 && entries[i].is_occupied())
+      return std::make_tuple(true, TableData(entries[i]),
+                             TableWriter(cluster, i, table_age));
   }
+
+  // Replacement: the entry with the lowest replacement value, empty entries
+  // go first
+  size_t replacement_index = 0;
+  int replacement_score = replacement_value(entries[0]);
+
+  for (size_t i = 1; i < CLUSTER_SIZE; ++i) {
+    int score = replacement_value(entries[i]);
+
+    if (score < replacement_score) {
+      replacement_score = score;
+      replacement_index = i;
+    }
+  }
+
+  return std::make_tuple(false, TableData(entries[replacement_index]),
+                         TableWriter(cluster, replacement_index, table_age));
 }
 
-}  // namespace Juujfish
\ No newline at end of file
+}  // namespace Juujfish
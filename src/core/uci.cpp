@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+
+#include "uci.h"
+
+#include "benchmark.h"
+#include "misc.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "perftgen.h"
+
+namespace Juujfish {
+
+std::string UCI::value(Value v) {
+  if (v >= VALUE_MATE - MAX_PLY)
+    return "mate " + std::to_string((VALUE_MATE - v + 1) / 2);
+
+  if (v <= -VALUE_MATE + MAX_PLY)
+    return "mate " + std::to_string(-(VALUE_MATE + v) / 2);
+
+  return "cp " + std::to_string(v);
+}
+
+std::string UCI::move(Move m) {
+  return m.is_nullmove() ? "0000" : moveToString(m);
+}
+
+UCIEngine::UCIEngine() : threads(&tt, DEFAULT_UCI_THREADS) {
+  tt.resize(DEFAULT_TABLE_MB, threads);
+
+  states = StatesDequePtr(new std::deque<StateInfo>(1));
+  pos.set(START_FEN, &states->back());
+  game_fen = START_FEN;
+}
+
+UCIEngine::~UCIEngine() {
+  threads.stop = true;
+  threads.wait_for_search_finished();
+}
+
+void UCIEngine::loop(int argc, char* argv[]) {
+  std::string cmd, token;
+
+  for (int i = 1; i < argc; ++i)
+    cmd += std::string(argv[i]) + " ";
+
+  do {
+    // Wait for a command, an end of input is treated as quit
+    if (argc == 1 && !std::getline(std::cin, cmd))
+      cmd = "quit";
+
+    std::istringstream is(cmd);
+
+    token.clear();
+    is >> std::skipws >> token;
+
+    if (token == "quit" || token == "stop") {
+      threads.stop = true;
+
+    } else if (token == "ponderhit") {
+      // The opponent played the expected move, the search continues on our
+      // clock and stops right away if it already used its time
+      threads.ponder = false;
+      if (threads.stop_on_ponderhit)
+        threads.stop = true;
+
+    } else if (token == "uci") {
+      std::cout << "id name " << ENGINE_NAME << "\n"
+                << "id author " << ENGINE_AUTHOR << "\n"
+                << "option name Hash type spin default " << DEFAULT_TABLE_MB
+                << " min 1 max " << MAX_TABLE_MB << "\n"
+                << "option name Threads type spin default "
+                << DEFAULT_UCI_THREADS << " min 1 max " << MAX_UCI_THREADS
+                << "\n"
+                << "option name Ponder type check default false\n"
+                << "option name EvalFile type string default <empty>\n"
+                << "uciok" << std::endl;
+
+    } else if (token == "isready") {
+      std::cout << "readyok" << std::endl;
+
+    } else if (token == "setoption") {
+      setoption(is);
+    } else if (token == "ucinewgame") {
+      new_game();
+    } else if (token == "position") {
+      position(is);
+    } else if (token == "go") {
+      go(is);
+    } else if (token == "bench") {
+      bench(is);
+    } else if (token == "d") {
+      std::cout << pretty(pos) << "\nFen: " << pos.fen() << std::endl;
+    } else if (!token.empty()) {
+      std::cout << "Unknown command: '" << cmd << "'" << std::endl;
+    }
+
+  } while (token != "quit" && argc == 1);
+}
+
+void UCIEngine::position(std::istringstream& is) {
+  std::string token, fen;
+  std::vector<std::string> moves;
+
+  is >> token;
+
+  if (token == "startpos") {
+    fen = START_FEN;
+    is >> token;  // Consume the "moves" token, if any
+  } else if (token == "fen") {
+    while (is >> token && token != "moves")
+      fen += (fen.empty() ? "" : " ") + token;
+  } else {
+    return;
+  }
+
+  while (is >> token)
+    moves.push_back(token);
+
+  threads.wait_for_search_finished();
+
+  // Only replay the new moves when the game continues from the last position
+  bool continues_game =
+      fen == game_fen && moves.size() >= game_moves.size() &&
+      std::equal(game_moves.begin(), game_moves.end(), moves.begin());
+
+  if (!continues_game) {
+    states = StatesDequePtr(new std::deque<StateInfo>(1));
+    pos.set(fen, &states->back());
+
+    game_fen = fen;
+    game_moves.clear();
+  }
+
+  for (size_t i = game_moves.size(); i < moves.size(); ++i) {
+    Move m = parseMove(pos, moves[i]);
+
+    if (m.is_nullmove()) {
+      std::cout << "info string Illegal move " << moves[i] << std::endl;
+      break;
+    }
+
+    states->emplace_back();
+    pos.make_move(m, &states->back(), pos.gives_check(m));
+    game_moves.push_back(moves[i]);
+  }
+}
+
+void UCIEngine::go(std::istringstream& is) {
+  SearchLimits limits;
+  std::string token;
+
+  // Start the clock as soon as possible
+  limits.start_time = now();
+
+  while (is >> token) {
+    if (token == "wtime")
+      is >> limits.time[WHITE];
+    else if (token == "btime")
+      is >> limits.time[BLACK];
+    else if (token == "winc")
+      is >> limits.inc[WHITE];
+    else if (token == "binc")
+      is >> limits.inc[BLACK];
+    else if (token == "movestogo")
+      is >> limits.movestogo;
+    else if (token == "movetime")
+      is >> limits.movetime;
+    else if (token == "depth")
+      is >> limits.depth;
+    else if (token == "nodes")
+      is >> limits.nodes;
+    else if (token == "mate")
+      is >> limits.mate;
+    else if (token == "infinite")
+      limits.infinite = true;
+    else if (token == "ponder")
+      limits.ponder = true;
+    else if (token == "perft") {
+      Depth depth = 0;
+      is >> depth;
+
+      threads.wait_for_search_finished();
+
+      TimePoint start = now();
+      std::uint64_t nodes = Perft::perft(pos, depth, threads);
+      TimePoint elapsed = now() - start;
+
+      std::cout << "\nNodes searched: " << nodes << "\nTime: " << elapsed
+                << " ms\nNPS: " << nodes * 1000 / (elapsed + 1) << "\n"
+                << std::endl;
+      return;
+    }
+  }
+
+  threads.start(pos, states, limits);
+}
+
+void UCIEngine::setoption(std::istringstream& is) {
+  std::string token, name, value;
+
+  is >> token;  // Consume the "name" token
+
+  while (is >> token && token != "value")
+    name += (name.empty() ? "" : " ") + token;
+
+  while (is >> token)
+    value += (value.empty() ? "" : " ") + token;
+
+  threads.wait_for_search_finished();
+
+  if (name == "Threads") {
+    int num_threads = std::clamp(std::atoi(value.c_str()), 1, MAX_UCI_THREADS);
+    threads.set(num_threads);
+  } else if (name == "Hash") {
+    size_t mb = std::clamp(std::strtoull(value.c_str(), nullptr, 10), 1ULL,
+                           (unsigned long long)MAX_TABLE_MB);
+    tt.resize(mb, threads);
+
+    std::cout << "info string Hash " << tt.size_mb() << " MB using "
+              << to_string(tt.page_mode()) << std::endl;
+  } else if (name == "EvalFile") {
+    // An empty value switches back to the hand-crafted evaluation
+    if (value.empty() || value == "<empty>")
+      NNUE::unload();
+    else
+      NNUE::load(value);
+
+    if (NNUE::is_loaded())
+      std::cout << "info string NNUE evaluation using " << NNUE::loaded_file()
+                << std::endl;
+    else
+      std::cout << "info string Classical evaluation" << std::endl;
+  } else if (name != "Ponder") {
+    std::cout << "info string No such option: " << name << std::endl;
+  }
+}
+
+void UCIEngine::new_game() {
+  threads.wait_for_search_finished();
+
+  tt.clear(threads);
+  threads.clear();
+}
+
+void UCIEngine::bench(std::istringstream& is) {
+  size_t hash_mb = DEFAULT_BENCH_HASH_MB;
+  int num_threads = DEFAULT_BENCH_THREADS;
+  Depth depth = DEFAULT_BENCH_DEPTH;
+
+  std::string token;
+
+  if (is >> token)
+    hash_mb = std::clamp(std::strtoull(token.c_str(), nullptr, 10), 1ULL,
+                         (unsigned long long)MAX_TABLE_MB);
+  if (is >> token)
+    num_threads = std::clamp(std::atoi(token.c_str()), 1, MAX_UCI_THREADS);
+  if (is >> token)
+    depth = std::clamp(std::atoi(token.c_str()), 1, int(MAX_PLY) - 1);
+
+  threads.wait_for_search_finished();
+  threads.set(num_threads);
+  tt.resize(hash_mb, threads);
+  new_game();
+
+  std::uint64_t nodes = 0;
+  TimePoint elapsed = 0;
+  size_t count = std::size(BENCH_FENS);
+
+  for (size_t i = 0; i < count; ++i) {
+    std::cout << "\nPosition: " << i + 1 << "/" << count << " ("
+              << BENCH_FENS[i] << ")" << std::endl;
+
+    std::istringstream position_is(std::string("fen ") + BENCH_FENS[i]);
+    position(position_is);
+
+    SearchLimits limits;
+    limits.depth = depth;
+    limits.start_time = now();
+
+    threads.start(pos, states, limits);
+    threads.wait_for_search_finished();
+
+    elapsed += now() - limits.start_time;
+    nodes += threads.nodes_searched();
+  }
+
+  std::cout << "\n==========================="
+            << "\nTotal time (ms) : " << elapsed
+            << "\nNodes searched  : " << nodes
+            << "\nNodes/second    : " << nodes * 1000 / (elapsed + 1)
+            << std::endl;
+}
+
+}  // namespace Juujfish
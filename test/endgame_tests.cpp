@@ -0,0 +1,68 @@
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+
+#include "bitboard.h"
+#include "endgame.h"
+#include "evaluation.h"
+#include "position.h"
+
+using namespace Juujfish;
+
+namespace {
+
+struct EndgamePosition {
+  const char* name;
+  const char* fen;
+  bool won;  // By white, otherwise drawn
+};
+
+constexpr EndgamePosition ENDGAME_POSITIONS[] = {
+    {"KPK won", "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", true},
+    {"KPK opposition", "8/8/8/8/8/4k3/4P3/4K3 w - - 0 1", false},
+    {"KPK rook pawn", "k7/8/K7/P7/8/8/8/8 w - - 0 1", false},
+    {"KRK", "8/8/8/3k4/8/8/8/R3K3 b - - 0 1", true},
+    {"KRK stalemate", "k7/1R6/2K5/8/8/8/8/8 b - - 0 1", false},
+    {"KRK hanging rook", "8/8/8/3k4/4R3/8/8/6K1 b - - 0 1", false},
+    {"KRK hanging rook, white to move", "8/8/8/3k4/4R3/8/8/6K1 w - - 0 1",
+     true},
+    {"KBNK", "8/8/8/3k4/8/8/8/NB2K3 w - - 0 1", true},
+    {"KBNK stalemate", "k7/3N4/1K6/8/8/8/8/4B3 b - - 0 1", false},
+};
+
+}  // namespace
+
+/*
+  Evaluates positions of the known endings and checks that each is scored as
+  a win for white or as an exact draw.
+*/
+int main() {
+  BitBoards::init();
+  Position::init();
+  Bitbases::init();
+
+  auto pawn_table = std::make_unique<PawnTable>();
+  auto material_table = std::make_unique<MaterialTable>();
+
+  int failures = 0;
+
+  for (const EndgamePosition& test : ENDGAME_POSITIONS) {
+    StateInfo st;
+    Position pos;
+    pos.set(test.fen, &st);
+
+    Value v = evaluate(pos, *pawn_table, *material_table);
+    bool passed = test.won ? v > VALUE_KNOWN_WIN : v == VALUE_DRAW;
+    failures += !passed;
+
+    std::cout << (passed ? "[ OK ] " : "[FAIL] ") << test.name << "  eval "
+              << v << std::endl;
+  }
+
+  std::cout << "\n"
+            << failures << " of " << std::size(ENDGAME_POSITIONS)
+            << " positions failed" << std::endl;
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+#include "perft.h"
+
+#include "bitboard.h"
+#include "misc.h"
+#include "perftgen.h"
+#include "position.h"
+#include "search.h"
+#include "thread.h"
+#include "transposition.h"
+
+using namespace Juujfish;
+
+/*
+  Runs perft on every test position and compares the node counts with the
+  reference. Usage: perft_tests [threads] [hash MiB]. The defaults, one thread
+  and no hashing, make the reported speed a measure of move generation and
+  make/unmake alone.
+*/
+int main(int argc, char* argv[]) {
+  BitBoards::init();
+  Position::init();
+  Search::init();
+
+  int num_threads = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 1;
+  size_t hash_mb = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+
+  TranspositionTable tt;
+  ThreadPool threads(&tt, num_threads);
+
+  std::uint64_t total_nodes = 0;
+  TimePoint total_time = 0;
+  int failures = 0;
+
+  for (const PerftPosition& test : PERFT_POSITIONS) {
+    StateInfo st;
+    Position pos;
+    pos.set(test.fen, &st);
+
+    TimePoint start = now();
+    std::uint64_t nodes =
+        Perft::perft(pos, test.depth, threads, hash_mb, false);
+    TimePoint elapsed = now() - start;
+
+    bool passed = nodes == test.nodes;
+    failures += !passed;
+
+    total_nodes += nodes;
+    total_time += elapsed;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << (passed ? "[ OK ] " : "[FAIL] ") << std::left
+              << std::setw(24) << test.name << " depth " << test.depth
+              << "  nodes " << std::setw(11) << nodes << " "
+              << std::setw(8) << nodes / 1000.0 / (elapsed + 1)
+              << " MNPS";
+
+    if (!passed)
+      std::cout << "  expected " << test.nodes;
+
+    std::cout << std::endl;
+  }
+
+  std::cout << "\nTotal nodes " << total_nodes << " in " << total_time
+            << " ms, " << total_nodes / 1000.0 / (total_time + 1) << " MNPS\n"
+            << failures << " of " << std::size(PERFT_POSITIONS)
+            << " positions failed" << std::endl;
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}